@@ -0,0 +1,128 @@
+#include "AdaptiveSampler.h"
+#include <algorithm>
+
+namespace {
+
+// Samples of one tile plus a one pixel apron on the right and top, so blocks
+// on the tile border can use the corners they share with the next tile.
+struct SampleGrid{
+    const LensingTracer& tracer;
+    const LensingCamera& camera;
+    glm::vec2 jitter;
+    int x0, y0, width, height;
+
+    std::vector<TraceResult> hits;
+    std::vector<glm::vec3> deflection;   // escape direction - initial direction
+    std::vector<unsigned char> traced;
+    long long rays = 0;
+    long long steps = 0;
+
+    SampleGrid(const LensingTracer& t, const LensingCamera& c, glm::vec2 j, int gx0, int gy0, int w, int h)
+        : tracer(t), camera(c), jitter(j), x0(gx0), y0(gy0), width(w), height(h),
+          hits(static_cast<size_t>(w) * h), deflection(hits.size()), traced(hits.size(), 0) {}
+
+    size_t Index(int x, int y) const { return static_cast<size_t>(y - y0) * width + (x - x0); }
+
+    const TraceResult& Sample(int x, int y){
+        size_t i = Index(x, y);
+        if (!traced[i]) {
+            glm::vec3 dir = tracer.PixelDirection(camera, x + jitter.x, y + jitter.y);
+            hits[i] = tracer.Trace(camera.position, dir);
+            deflection[i] = hits[i].direction - dir;
+            traced[i] = 1;
+            ++rays;
+            steps += hits[i].steps;
+        }
+        return hits[i];
+    }
+};
+
+}
+
+// Refine the block with corners (bx0,by0)-(bx1,by1), all already traced.
+static void refineBlock(SampleGrid& grid, float threshold, int bx0, int by0, int bx1, int by1){
+    // Blocks of at most 2x2 pixels are made of corners only
+    if (bx1 - bx0 <= 1 && by1 - by0 <= 1) return;
+
+    const int cx[4] = { bx0, bx1, bx0, bx1 };
+    const int cy[4] = { by0, by0, by1, by1 };
+    bool split = false;
+    for (int i = 0; i < 4 && !split; ++i) {
+        for (int j = i + 1; j < 4 && !split; ++j) {
+            size_t a = grid.Index(cx[i], cy[i]), b = grid.Index(cx[j], cy[j]);
+            split = grid.hits[a].captured != grid.hits[b].captured
+                 || glm::length(grid.deflection[a] - grid.deflection[b]) > threshold;
+        }
+    }
+
+    if (split) {
+        // Halve each side that is longer than one pixel
+        int xm = (bx0 + bx1) / 2, ym = (by0 + by1) / 2;
+        int xs[3] = { bx0, xm, bx1 }, ys[3] = { by0, ym, by1 };
+        int nx = bx1 - bx0 > 1 ? 2 : 1, ny = by1 - by0 > 1 ? 2 : 1;
+        if (nx == 1) xs[1] = bx1;
+        if (ny == 1) ys[1] = by1;
+
+        for (int j = 0; j <= ny; ++j) {
+            for (int i = 0; i <= nx; ++i) grid.Sample(xs[i], ys[j]);
+        }
+        for (int j = 0; j < ny; ++j) {
+            for (int i = 0; i < nx; ++i) refineBlock(grid, threshold, xs[i], ys[j], xs[i + 1], ys[j + 1]);
+        }
+        return;
+    }
+
+    // Smooth block: bilinear interpolation of the corner escape directions.
+    // Pixels that were traced keep their own result.
+    float spanX = static_cast<float>(std::max(1, bx1 - bx0));
+    float spanY = static_cast<float>(std::max(1, by1 - by0));
+    bool captured = grid.hits[grid.Index(bx0, by0)].captured;
+    const glm::vec3& d00 = grid.hits[grid.Index(bx0, by0)].direction;
+    const glm::vec3& d10 = grid.hits[grid.Index(bx1, by0)].direction;
+    const glm::vec3& d01 = grid.hits[grid.Index(bx0, by1)].direction;
+    const glm::vec3& d11 = grid.hits[grid.Index(bx1, by1)].direction;
+
+    for (int y = by0; y <= by1; ++y) {
+        for (int x = bx0; x <= bx1; ++x) {
+            size_t i = grid.Index(x, y);
+            if (grid.traced[i]) continue;
+            float u = (x - bx0) / spanX, v = (y - by0) / spanY;
+            glm::vec3 d = glm::mix(glm::mix(d00, d10, u), glm::mix(d01, d11, u), v);
+            grid.hits[i] = TraceResult{ captured, glm::length(d) > 0.0f ? glm::normalize(d) : d00, 0 };
+        }
+    }
+}
+
+long long AdaptiveSampler::SampleTile(const LensingTracer& tracer, const LensingCamera& camera, glm::vec2 jitter,
+                                      int x0, int y0, int x1, int y1,
+                                      std::vector<glm::vec3>& colors, long long& steps) const{
+    // Grid covers the tile plus the first row/column of the next tile, if any
+    int gx1 = std::min(x1, camera.width - 1);
+    int gy1 = std::min(y1, camera.height - 1);
+    SampleGrid grid(tracer, camera, jitter, x0, y0, gx1 - x0 + 1, gy1 - y0 + 1);
+
+    // Blocks share their edges; a block starting on the last column or row is
+    // only needed when the tile is a single pixel wide or tall
+    int spacing = std::max(1, coarseSpacing);
+    for (int by = y0; by < gy1 || by == y0; by += spacing) {
+        for (int bx = x0; bx < gx1 || bx == x0; bx += spacing) {
+            int bx1 = std::min(bx + spacing, gx1), by1 = std::min(by + spacing, gy1);
+            grid.Sample(bx, by);
+            grid.Sample(bx1, by);
+            grid.Sample(bx, by1);
+            grid.Sample(bx1, by1);
+            refineBlock(grid, deflectionThreshold, bx, by, bx1, by1);
+        }
+    }
+
+    int tileWidth = x1 - x0;
+    colors.resize(static_cast<size_t>(tileWidth) * (y1 - y0));
+    for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; ++x) {
+            colors[static_cast<size_t>(y - y0) * tileWidth + (x - x0)] = LensingTracer::Shade(grid.hits[grid.Index(x, y)]);
+        }
+    }
+
+    steps += grid.steps;
+    return grid.rays;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "LensingTracer.h"
+#include <vector>
+
+// Adaptive image-space sampling for the tile renderer.
+// Geodesics are first traced on a coarse grid. A block is split in four only
+// when its corner rays disagree on capture or their deflections differ by more
+// than deflectionThreshold, which in practice only happens along the shadow
+// edge and the photon ring. Smooth blocks are filled by interpolating the
+// escape directions of the corners, so the sky is still looked up per pixel.
+struct AdaptiveSampler{
+    int coarseSpacing = 16;             // pixels between first-pass samples
+    float deflectionThreshold = 0.05f;  // radians
+
+    // Shade pixels [x0,x1) x [y0,y1) into colors (row-major, (x1-x0) wide).
+    // Returns the number of rays traced; their RK4 steps are added to steps.
+    long long SampleTile(const LensingTracer& tracer, const LensingCamera& camera, glm::vec2 jitter,
+                         int x0, int y0, int x1, int y1,
+                         std::vector<glm::vec3>& colors, long long& steps) const;
+};
@@ -1,20 +1,12 @@
 #pragma once 
-#include "config.h"
+#include "core_config.h"
 struct BlackHole{
     glm::vec3 position; 
     double mass;        
     double radius;     
     double r_s;         // Schwarzschild radius (event horizon radius)
-    glm::mat4 model = glm::mat4(1.0f);
-
-    GLuint VAO, VBO;    
-    GLuint EBO;
-    GLsizei indexCount = 0;
+    double spin = 0.0;  // Kerr a/M in (-1, 1) about the world z axis; nonzero makes rays integrate Kerr geodesics
 
     // Constructor to initialize the black hole with position and mass
     BlackHole(glm::vec3 pos, double m);
-
-    // Set up the mesh for rendering the black hole
-    void SetupMesh();
-    void Draw(GLuint shaderProgram);
-};
\ No newline at end of file
+};
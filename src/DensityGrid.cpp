@@ -0,0 +1,96 @@
+#include "DensityGrid.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+size_t DensityGrid::cellCount() const{
+    if (mode == DensityMode::Screen) return static_cast<size_t>(width) * height;
+    return static_cast<size_t>(resolution) * resolution * resolution;
+}
+
+void DensityGrid::Reserve(unsigned int workers){
+    if (grid.size() != cellCount()) {
+        grid.assign(cellCount(), 0.0f);
+        tiles.clear();
+    }
+    if (tiles.size() < workers) tiles.resize(workers, std::vector<float>(cellCount(), 0.0f));
+}
+
+void DensityGrid::Clear(){
+    std::fill(grid.begin(), grid.end(), 0.0f);
+    for (auto& tile : tiles) std::fill(tile.begin(), tile.end(), 0.0f);
+}
+
+long long DensityGrid::cellOf(glm::vec3 position) const{
+    if (mode == DensityMode::Screen) {
+        glm::vec4 clip = viewProjection * glm::vec4(position, 1.0f);
+        if (clip.w <= 0.0f) return -1;
+        float x = (clip.x / clip.w * 0.5f + 0.5f) * width;
+        float y = (clip.y / clip.w * 0.5f + 0.5f) * height;
+        if (x < 0.0f || y < 0.0f || x >= width || y >= height) return -1;
+        return static_cast<long long>(y) * width + static_cast<long long>(x);
+    }
+    glm::vec3 u = (position / extent * 0.5f + 0.5f) * float(resolution);
+    if (u.x < 0.0f || u.y < 0.0f || u.z < 0.0f || u.x >= resolution || u.y >= resolution || u.z >= resolution) return -1;
+    long long n = resolution;
+    return (static_cast<long long>(u.z) * n + static_cast<long long>(u.y)) * n + static_cast<long long>(u.x);
+}
+
+void DensityGrid::Splat(unsigned int worker, glm::vec3 position, float weight){
+    long long cell = cellOf(position);
+    if (cell >= 0) tiles[worker][static_cast<size_t>(cell)] += weight;
+}
+
+void DensityGrid::Merge(unsigned int threads){
+    size_t count = grid.size();
+    unsigned int workers = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+    workers = static_cast<unsigned int>(std::min<size_t>(workers, std::max<size_t>(1, count / 4096)));
+
+    // Each worker owns a contiguous slice of cells across all tiles
+    auto work = [&](unsigned int worker){
+        size_t begin = count * worker / workers;
+        size_t end = count * (worker + 1) / workers;
+        for (size_t i = begin; i < end; ++i) grid[i] *= fade;
+        for (auto& tile : tiles) {
+            for (size_t i = begin; i < end; ++i) {
+                grid[i] += tile[i];
+                tile[i] = 0.0f;
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned int w = 1; w < workers; ++w) pool.emplace_back(work, w);
+    work(0);
+    for (auto& t : pool) t.join();
+}
+
+std::vector<glm::vec3> DensityGrid::ToneMap(int& imageWidth, int& imageHeight, float exposure) const{
+    std::vector<float> image;
+    if (mode == DensityMode::Screen) {
+        imageWidth = width;
+        imageHeight = height;
+        image = grid;
+    } else {
+        imageWidth = imageHeight = resolution;
+        size_t n = static_cast<size_t>(resolution);
+        image.assign(n * n, 0.0f);
+        if (grid.size() == n * n * n) {
+            for (size_t z = 0; z < n; ++z) {
+                for (size_t i = 0; i < n * n; ++i) image[i] += grid[z * n * n + i];
+            }
+        }
+    }
+
+    float peak = 0.0f;
+    for (float d : image) peak = std::max(peak, d);
+    float scale = peak > 0.0f ? 1.0f / std::log1p(exposure * peak) : 0.0f;
+
+    // Black through red and yellow to white
+    std::vector<glm::vec3> pixels(image.size());
+    for (size_t i = 0; i < image.size(); ++i) {
+        float t = std::log1p(exposure * image[i]) * scale;
+        pixels[i] = glm::clamp(glm::vec3(3.0f * t, 3.0f * t - 1.0f, 3.0f * t - 2.0f), 0.0f, 1.0f);
+    }
+    return pixels;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "core_config.h"
+#include <vector>
+
+// Where DensityGrid bins photons
+enum class DensityMode {
+    Screen,     // pixels of the current view
+    Volume,     // voxels of a cube around the hole, shown summed along z
+};
+
+// Photon density accumulated on a fixed grid, for ray counts whose trails
+// would be noise (and too much memory) to draw one by one. Every frame each
+// active ray adds its weight to the cell it is in. Workers splat into tiles
+// of their own, so the hot loop takes no locks and shares no cache lines;
+// Merge then sums the tiles into the grid, each worker reducing a slice of
+// the cells. Memory is workers + 1 grids, whatever the number of rays.
+struct DensityGrid{
+    bool enabled = false;
+    DensityMode mode = DensityMode::Screen;
+    int width = 800, height = 600;      // screen mode
+    int resolution = 128;               // volume mode, voxels per side
+    float extent = 5.0f;                // volume mode, half size of the cube, screen units
+    float fade = 1.0f;                  // grid scale per merge; below 1 old light fades like a trail
+    glm::mat4 viewProjection = glm::mat4(1.0f); // screen mode camera
+
+    // Makes sure there is a tile for each of workers and that all buffers
+    // match the grid settings. The density is kept unless the size changed.
+    void Reserve(unsigned int workers);
+    void Clear();
+
+    // Adds weight at position to the worker's tile (Reserve first)
+    void Splat(unsigned int worker, glm::vec3 position, float weight);
+
+    // Sums the tiles into the grid (after fading it) and zeroes them, on
+    // the given number of threads
+    void Merge(unsigned int threads);
+
+    // Accumulated density: width x height for the screen, resolution³ for
+    // the volume (x fastest)
+    const std::vector<float>& Cells() const { return grid; }
+    unsigned int Tiles() const { return static_cast<unsigned int>(tiles.size()); }
+
+    // Logarithmic tone map of the grid to an image, row 0 at the bottom;
+    // the volume is summed along z. exposure scales the density before the
+    // log, the brightest cell maps to white.
+    std::vector<glm::vec3> ToneMap(int& imageWidth, int& imageHeight, float exposure = 1.0f) const;
+
+private:
+    std::vector<float> grid;
+    std::vector<std::vector<float>> tiles;
+
+    size_t cellCount() const;
+    // Cell of position, or -1 outside the grid
+    long long cellOf(glm::vec3 position) const;
+};
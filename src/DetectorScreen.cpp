@@ -0,0 +1,64 @@
+#include "DetectorScreen.h"
+#include <algorithm>
+#include <cmath>
+
+void DetectorScreen::Reserve(unsigned int workers){
+    size_t cells = static_cast<size_t>(width) * height;
+    if (image.size() != cells) {
+        image.assign(cells, 0.0f);
+        histograms.clear();
+        hitsBy.clear();
+        hits = 0;
+    }
+    if (histograms.size() < workers) {
+        histograms.resize(workers, std::vector<float>(cells, 0.0f));
+        hitsBy.resize(workers);
+    }
+}
+
+void DetectorScreen::Clear(){
+    std::fill(image.begin(), image.end(), 0.0f);
+    for (auto& histogram : histograms) std::fill(histogram.begin(), histogram.end(), 0.0f);
+    std::fill(hitsBy.begin(), hitsBy.end(), HitCount());
+    hits = 0;
+}
+
+void DetectorScreen::Record(unsigned int worker, glm::vec3 a, glm::vec3 b, float weight){
+    glm::vec3 n = glm::normalize(normal);
+    float da = glm::dot(a - center, n), db = glm::dot(b - center, n);
+    if (!(da < 0.0f && db >= 0.0f)) return;
+
+    // Crossing point on the plane, in the detector's own axes
+    glm::vec3 hit = a + (b - a) * (da / (da - db));
+    glm::vec3 v = glm::normalize(up - glm::dot(up, n) * n);
+    glm::vec3 u = glm::cross(v, n);
+    glm::vec3 d = hit - center;
+    float x = (glm::dot(d, u) / halfWidth * 0.5f + 0.5f) * width;
+    float y = (glm::dot(d, v) / halfHeight * 0.5f + 0.5f) * height;
+    if (x < 0.0f || y < 0.0f || x >= width || y >= height) return;
+
+    histograms[worker][static_cast<size_t>(y) * width + static_cast<size_t>(x)] += weight;
+    ++hitsBy[worker].value;
+}
+
+void DetectorScreen::Merge(){
+    for (size_t w = 0; w < histograms.size(); ++w) {
+        if (hitsBy[w].value == 0) continue;   // nothing landed: the histogram is still zero
+        auto& histogram = histograms[w];
+        for (size_t i = 0; i < image.size(); ++i) {
+            image[i] += histogram[i];
+            histogram[i] = 0.0f;
+        }
+        hits += hitsBy[w].value;
+        hitsBy[w].value = 0;
+    }
+}
+
+std::vector<glm::vec3> DetectorScreen::Normalized() const{
+    float peak = 0.0f;
+    for (float value : image) peak = std::max(peak, value);
+    std::vector<glm::vec3> pixels(image.size(), glm::vec3(0.0f));
+    if (peak <= 0.0f) return pixels;
+    for (size_t i = 0; i < image.size(); ++i) pixels[i] = glm::vec3(std::sqrt(image[i] / peak));
+    return pixels;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "core_config.h"
+#include <vector>
+
+// A virtual detector: a rectangle in the scene that bins where rays cross it,
+// so the forward simulation builds up a lensed image (Einstein ring,
+// multiple images) from hits alone, without keeping any trail. Each frame a
+// ray's motion is the segment from its previous to its current position;
+// crossings from the back to the front (along normal) are added, with the
+// ray's weight, to the worker's own histogram. Merge sums the histograms
+// once per Simulation::Run, so there are no locks or atomics on the hot path.
+struct DetectorScreen{
+    bool enabled = false;
+    glm::vec3 center = glm::vec3(6.0f, 0.0f, 0.0f);
+    glm::vec3 normal = glm::vec3(1.0f, 0.0f, 0.0f);     // rays crossing along it are counted
+    glm::vec3 up = glm::vec3(0.0f, 0.0f, 1.0f);         // image y, made orthogonal to normal
+    float halfWidth = 3.0f, halfHeight = 3.0f;          // screen units
+    int width = 256, height = 256;                      // pixels
+
+    // Makes sure there is a histogram for each of workers; the image is
+    // kept unless its size changed
+    void Reserve(unsigned int workers);
+    void Clear();
+
+    // Counts the segment from a to b if it crosses the detector front-wards
+    void Record(unsigned int worker, glm::vec3 a, glm::vec3 b, float weight);
+
+    // Adds the workers' histograms to the image and zeroes them
+    void Merge();
+
+    // Accumulated weight per pixel, row 0 at the bottom, and total hits
+    const std::vector<float>& Image() const { return image; }
+    long long Hits() const { return hits; }
+
+    // Image scaled so the brightest pixel is white (gamma 1/2 to lift the
+    // faint secondary images), ready for WritePNG
+    std::vector<glm::vec3> Normalized() const;
+
+private:
+    std::vector<float> image;
+    std::vector<std::vector<float>> histograms;
+    // Per worker, since the last merge; one cache line each, as every
+    // worker bumps its own on each hit
+    struct alignas(64) HitCount{ long long value = 0; };
+    std::vector<HitCount> hitsBy;
+    long long hits = 0;
+};
@@ -0,0 +1,107 @@
+#include "ImageIO.h"
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+
+// 8-bit RGB rows, top row first
+static std::vector<unsigned char> toBytes(const std::vector<glm::vec3>& pixels, int width, int height){
+    std::vector<unsigned char> bytes(static_cast<size_t>(width) * height * 3);
+    size_t out = 0;
+    for (int y = height - 1; y >= 0; --y) {
+        for (int x = 0; x < width; ++x) {
+            glm::vec3 c = glm::clamp(pixels[static_cast<size_t>(y) * width + x], 0.0f, 1.0f);
+            bytes[out++] = static_cast<unsigned char>(c.r * 255.0f + 0.5f);
+            bytes[out++] = static_cast<unsigned char>(c.g * 255.0f + 0.5f);
+            bytes[out++] = static_cast<unsigned char>(c.b * 255.0f + 0.5f);
+        }
+    }
+    return bytes;
+}
+
+bool WritePPM(const std::string& path, const std::vector<glm::vec3>& pixels, int width, int height){
+    std::ofstream file(path, std::ios::binary);
+    if (!file) return false;
+
+    std::vector<unsigned char> bytes = toBytes(pixels, width, height);
+    file << "P6\n" << width << " " << height << "\n255\n";
+    file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    return static_cast<bool>(file);
+}
+
+static uint32_t crc32(const unsigned char* data, size_t size, uint32_t crc = 0){
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+    }
+    return ~crc;
+}
+
+static void putU32(std::vector<unsigned char>& out, uint32_t v){
+    out.push_back(static_cast<unsigned char>(v >> 24));
+    out.push_back(static_cast<unsigned char>(v >> 16));
+    out.push_back(static_cast<unsigned char>(v >> 8));
+    out.push_back(static_cast<unsigned char>(v));
+}
+
+static void writeChunk(std::ofstream& file, const char* type, const std::vector<unsigned char>& data){
+    std::vector<unsigned char> chunk(type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+
+    std::vector<unsigned char> header;
+    putU32(header, static_cast<uint32_t>(data.size()));
+    std::vector<unsigned char> footer;
+    putU32(footer, crc32(chunk.data(), chunk.size()));
+
+    file.write(reinterpret_cast<const char*>(header.data()), header.size());
+    file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+    file.write(reinterpret_cast<const char*>(footer.data()), footer.size());
+}
+
+bool WritePNG(const std::string& path, const std::vector<glm::vec3>& pixels, int width, int height){
+    std::ofstream file(path, std::ios::binary);
+    if (!file) return false;
+
+    // Scanlines with filter type 0 in front of each row
+    std::vector<unsigned char> bytes = toBytes(pixels, width, height);
+    std::vector<unsigned char> raw;
+    size_t rowBytes = static_cast<size_t>(width) * 3;
+    raw.reserve((rowBytes + 1) * height);
+    for (int y = 0; y < height; ++y) {
+        raw.push_back(0);
+        raw.insert(raw.end(), bytes.begin() + y * rowBytes, bytes.begin() + (y + 1) * rowBytes);
+    }
+
+    // zlib stream made of stored deflate blocks (at most 65535 bytes each)
+    std::vector<unsigned char> z = { 0x78, 0x01 };
+    uint32_t a = 1, b = 0;
+    for (size_t pos = 0; ; ) {
+        size_t len = std::min<size_t>(65535, raw.size() - pos);
+        bool last = pos + len >= raw.size();
+        z.push_back(last ? 1 : 0);
+        z.push_back(static_cast<unsigned char>(len & 0xFF));
+        z.push_back(static_cast<unsigned char>(len >> 8));
+        z.push_back(static_cast<unsigned char>(~len & 0xFF));
+        z.push_back(static_cast<unsigned char>((~len >> 8) & 0xFF));
+        for (size_t i = pos; i < pos + len; i++) {
+            a = (a + raw[i]) % 65521;
+            b = (b + a) % 65521;
+        }
+        z.insert(z.end(), raw.begin() + pos, raw.begin() + pos + len);
+        pos += len;
+        if (last) break;
+    }
+    putU32(z, (b << 16) | a);
+
+    std::vector<unsigned char> ihdr;
+    putU32(ihdr, static_cast<uint32_t>(width));
+    putU32(ihdr, static_cast<uint32_t>(height));
+    ihdr.insert(ihdr.end(), { 8, 2, 0, 0, 0 }); // 8-bit RGB, no interlace
+
+    const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    file.write(reinterpret_cast<const char*>(signature), 8);
+    writeChunk(file, "IHDR", ihdr);
+    writeChunk(file, "IDAT", z);
+    writeChunk(file, "IEND", {});
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// Linear RGB pixels, row 0 at the bottom (OpenGL convention). Values are
+// clamped to [0,1] and rows are flipped so files read top to bottom.
+bool WritePPM(const std::string& path, const std::vector<glm::vec3>& pixels, int width, int height);
+
+// Same as WritePPM but as a PNG. The image data is stored uncompressed
+// (deflate "stored" blocks) so no zlib is needed.
+bool WritePNG(const std::string& path, const std::vector<glm::vec3>& pixels, int width, int height);
@@ -0,0 +1,136 @@
+#include "LensTree.h"
+#include <algorithm>
+#include <cmath>
+
+void LensTree::SetLenses(std::vector<PointLens> newLenses){
+    lenses = std::move(newLenses);
+    dirty = true;
+}
+
+void LensTree::MoveLens(size_t index, glm::dvec3 position){
+    lenses[index].position = position;
+    dirty = true;
+}
+
+void LensTree::Update(){
+    if (!dirty) return;
+    dirty = false;
+    nodes.clear();
+    order.resize(lenses.size());
+    for (size_t i = 0; i < lenses.size(); ++i) order[i] = static_cast<int>(i);
+    if (lenses.empty()) return;
+
+    // Root cube around every lens
+    glm::dvec3 lo = lenses[0].position, hi = lo;
+    for (const PointLens& lens : lenses) {
+        lo = glm::min(lo, lens.position);
+        hi = glm::max(hi, lens.position);
+    }
+    Node root;
+    root.center = 0.5 * (lo + hi);
+    root.halfSize = 0.5 * std::max({ hi.x - lo.x, hi.y - lo.y, hi.z - lo.z }) + 1e-9;
+    root.begin = 0;
+    root.end = static_cast<int>(order.size());
+    nodes.reserve(2 * lenses.size() / std::max(1, leafSize) + 1);
+    nodes.push_back(root);
+    build(0, 0);
+    ++builds;
+}
+
+void LensTree::build(int index, int depth){
+    Node node = nodes[index];
+
+    node.mass = 0.0;
+    node.massCenter = glm::dvec3(0.0);
+    for (int i = node.begin; i < node.end; ++i) {
+        const PointLens& lens = lenses[order[i]];
+        node.mass += lens.r_s;
+        node.massCenter += lens.r_s * lens.position;
+    }
+    node.massCenter = node.mass > 0.0 ? node.massCenter / node.mass : node.center;
+
+    // Coincident lenses would split forever; the depth cap turns them into a leaf
+    if (node.end - node.begin <= leafSize || depth >= 32) {
+        nodes[index] = node;
+        return;
+    }
+
+    // Partition the range into octants: by x, then y within each half, then z
+    auto begin = order.begin() + node.begin, end = order.begin() + node.end;
+    glm::dvec3 c = node.center;
+    auto splitX = std::partition(begin, end, [&](int i){ return lenses[i].position.x < c.x; });
+    std::vector<decltype(begin)> bounds = { begin, splitX, end };
+    for (int axis = 1; axis < 3; ++axis) {
+        std::vector<decltype(begin)> next;
+        for (size_t k = 0; k + 1 < bounds.size(); ++k) {
+            auto mid = std::partition(bounds[k], bounds[k + 1], [&](int i){ return lenses[i].position[axis] < c[axis]; });
+            next.push_back(bounds[k]);
+            next.push_back(mid);
+        }
+        next.push_back(end);
+        bounds = std::move(next);
+    }
+
+    // bounds holds 9 iterators; octant o has bit 0 for x, 1 for y, 2 for z
+    // above the center, in the order the partitions produced them
+    const int octantOf[8] = { 0, 4, 2, 6, 1, 5, 3, 7 };
+    node.firstChild = static_cast<int>(nodes.size());
+    node.childCount = 0;
+    for (int k = 0; k < 8; ++k) {
+        if (bounds[k] == bounds[k + 1]) continue;
+        int octant = octantOf[k];
+        Node child;
+        child.halfSize = 0.5 * node.halfSize;
+        child.center = c + child.halfSize * glm::dvec3(octant & 1 ? 1.0 : -1.0, octant & 2 ? 1.0 : -1.0,
+                                                       octant & 4 ? 1.0 : -1.0);
+        child.begin = static_cast<int>(bounds[k] - order.begin());
+        child.end = static_cast<int>(bounds[k + 1] - order.begin());
+        nodes.push_back(child);
+        ++node.childCount;
+    }
+    nodes[index] = node;
+    for (int k = 0; k < node.childCount; ++k) build(node.firstChild + k, depth + 1);
+}
+
+glm::dvec3 LensTree::pull(glm::dvec3 x, glm::dvec3 source, double mass) const{
+    glm::dvec3 d = source - x;
+    double d2 = glm::dot(d, d) + softening * softening;
+    return mass * d / (d2 * std::sqrt(d2));
+}
+
+glm::dvec3 LensTree::Field(glm::dvec3 x) const{
+    glm::dvec3 field(0.0);
+    if (nodes.empty()) return field;
+
+    int stack[256];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        if (node.firstChild < 0) {
+            for (int i = node.begin; i < node.end; ++i) field += pull(x, lenses[order[i]].position, lenses[order[i]].r_s);
+            continue;
+        }
+        glm::dvec3 d = node.massCenter - x;
+        double size = 2.0 * node.halfSize;
+        if (size * size < theta * theta * glm::dot(d, d)) {
+            field += pull(x, node.massCenter, node.mass);
+            continue;
+        }
+        // Depth is capped at 32 and each level pushes at most 8
+        for (int k = 0; k < node.childCount && top < 256; ++k) stack[top++] = node.firstChild + k;
+    }
+    return field;
+}
+
+glm::dvec3 LensTree::FieldDirect(glm::dvec3 x) const{
+    glm::dvec3 field(0.0);
+    for (const PointLens& lens : lenses) field += pull(x, lens.position, lens.r_s);
+    return field;
+}
+
+glm::dvec3 LensTree::Acceleration(glm::dvec3 x, glm::dvec3 dir) const{
+    glm::dvec3 v = glm::normalize(dir);
+    glm::dvec3 g = Field(x);
+    return g - glm::dot(g, v) * v;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "core_config.h"
+#include <vector>
+
+// A star (or any point mass) lensing the rays in the weak field
+struct PointLens{
+    glm::dvec3 position;
+    double r_s;         // Schwarzschild radius, screen units
+};
+
+// Barnes-Hut octree over many point lenses. The weak-field deflection of a
+// photon by a point mass is twice the Newtonian pull, transverse to its
+// direction:
+//   a = G - (G·v)v,  G = Σ r_s,i (x_i - x) / |x_i - x|³   (|v| = 1)
+// which integrates to the 2 r_s / b deflection per lens. Field sums G, using
+// a node's monopole whenever it looks smaller than theta from x, so a query
+// costs O(log N) instead of O(N). The tree is rebuilt by Update, and only
+// after lenses were set or moved.
+struct LensTree{
+    double theta = 0.5;         // opening angle: a node of size s at distance d is used whole when s < theta d
+    double softening = 0.02;    // Plummer softening, screen units; keeps near misses finite
+    int leafSize = 8;           // lenses per leaf, summed directly
+
+    void SetLenses(std::vector<PointLens> lenses);
+    void MoveLens(size_t index, glm::dvec3 position);
+    const std::vector<PointLens>& Lenses() const { return lenses; }
+    bool Empty() const { return lenses.empty(); }
+
+    // Rebuilds the tree if lenses changed since the last build. Not safe to
+    // call while other threads query the field.
+    void Update();
+
+    // G at x from the tree, and by direct summation over every lens
+    glm::dvec3 Field(glm::dvec3 x) const;
+    glm::dvec3 FieldDirect(glm::dvec3 x) const;
+
+    // Transverse weak-field acceleration of a photon at x moving along dir
+    glm::dvec3 Acceleration(glm::dvec3 x, glm::dvec3 dir) const;
+
+    size_t Nodes() const { return nodes.size(); }
+    long long Builds() const { return builds; }
+
+private:
+    struct Node{
+        glm::dvec3 center;      // geometric center of the cube
+        double halfSize;
+        glm::dvec3 massCenter;  // r_s weighted
+        double mass;            // total r_s
+        int firstChild = -1;    // children are stored contiguously
+        int childCount = 0;
+        int begin = 0, end = 0; // range of order covered by this node
+    };
+
+    std::vector<PointLens> lenses;
+    std::vector<Node> nodes;
+    std::vector<int> order;     // lens indices, grouped by node
+    bool dirty = false;
+    long long builds = 0;
+
+    void build(int node, int depth);
+    glm::dvec3 pull(glm::dvec3 x, glm::dvec3 source, double mass) const;
+};
@@ -0,0 +1,208 @@
+#include "LensedBackground.h"
+#include "view/shader.h"
+#include <algorithm>
+
+LensedBackground::LensedBackground(int w, int h, double r_s_screen)
+    : width(w), height(h), tracer(r_s_screen)
+{
+    color.assign(static_cast<size_t>(width) * height, glm::vec3(0.0f));
+    samples.assign(color.size(), 0);
+    sampleMean.assign(color.size(), glm::vec3(0.0f));
+    history.assign(color.size(), glm::vec3(0.0f));
+    historyWeight.assign(color.size(), 0.0f);
+    pendingPixels = color.size();
+    BuildRefinementOrder();
+    SetupMesh();
+
+    shader = make_shader(
+        "../src/shaders/background_vertex.txt",
+        "../src/shaders/background_fragment.txt");
+}
+
+LensedBackground::~LensedBackground(){
+    glDeleteTextures(1, &texture);
+    glDeleteBuffers(1, &VBO);
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteProgram(shader);
+}
+
+void LensedBackground::SetupMesh(){
+    // Full screen quad as a triangle strip, positions already in clip space
+    const float quad[] = {
+        -1.0f, -1.0f,
+         1.0f, -1.0f,
+        -1.0f,  1.0f,
+         1.0f,  1.0f,
+    };
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, color.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void LensedBackground::BuildRefinementOrder(){
+    // Rank every pixel by its entry in an 8x8 Bayer matrix. All rank 0 pixels
+    // come first (one per tile), then rank 1 (the opposite checkerboard cell),
+    // and so on, so any prefix of the order covers the image uniformly.
+    auto bayer8 = [](unsigned int x, unsigned int y){
+        unsigned int v = 0;
+        unsigned int xy = x ^ y;
+        for (int bit = 0; bit < 3; ++bit) {
+            v = (v << 2) | (((xy >> bit) & 1u) << 1) | ((y >> bit) & 1u);
+        }
+        return v;
+    };
+
+    std::vector<std::vector<unsigned int>> buckets(64);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            buckets[bayer8(x & 7, y & 7)].push_back(static_cast<unsigned int>(y * width + x));
+        }
+    }
+
+    order.clear();
+    order.reserve(color.size());
+    for (auto& bucket : buckets) {
+        order.insert(order.end(), bucket.begin(), bucket.end());
+    }
+}
+
+void LensedBackground::Update(const LensingCamera& camera, const glm::mat4& projection){
+    glm::mat4 viewProjection = projection * camera.view;
+
+    if (!hasHistory) {
+        prevViewProjection = viewProjection;
+        hasHistory = true;
+    } else if (viewProjection != prevViewProjection) {
+        Reproject(camera);
+        prevViewProjection = viewProjection;
+    }
+
+    if (pendingPixels > 0) {
+        Refine(camera);
+    }
+
+    if (dirty) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGB, GL_FLOAT, color.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+        dirty = false;
+    }
+}
+
+void LensedBackground::Reproject(const LensingCamera& camera){
+    // The orbit camera always looks at the black hole, so the lensed image is
+    // pinned to it. Treat each pixel as lying at the hole's distance, find where
+    // that point was on screen last frame and fetch the history from there.
+    float focusDistance = glm::length(camera.position);
+    LensingCamera pixelCamera = camera;
+    pixelCamera.width = width;
+    pixelCamera.height = height;
+
+    std::vector<glm::vec3> reprojected(color.size(), glm::vec3(0.0f));
+    std::vector<float> weight(color.size(), 0.0f);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            glm::vec3 dir = tracer.PixelDirection(pixelCamera, x + 0.5f, y + 0.5f);
+            glm::vec4 clip = prevViewProjection * glm::vec4(camera.position + dir * focusDistance, 1.0f);
+            if (clip.w <= 0.0f) continue;
+
+            float u = (clip.x / clip.w * 0.5f + 0.5f) * width;
+            float v = (clip.y / clip.w * 0.5f + 0.5f) * height;
+            int px = static_cast<int>(floorf(u));
+            int py = static_cast<int>(floorf(v));
+            if (px < 0 || py < 0 || px >= width || py >= height) continue;
+
+            size_t index = static_cast<size_t>(y) * width + x;
+            size_t source = static_cast<size_t>(py) * width + px;
+            reprojected[index] = color[source];
+            weight[index] = std::min(historySamples, samples[source] + remainingHistory(source));
+        }
+    }
+
+    // The history is only approximately where it was: it is kept as a
+    // down-weighted prior, and every pixel is traced again. Pixels that came
+    // from off screen start from nothing.
+    history = reprojected;
+    historyWeight.swap(weight);
+    color.swap(reprojected);
+    std::fill(samples.begin(), samples.end(), 0);
+    pendingPixels = color.size();
+    cursor = 0;
+    dirty = true;
+}
+
+void LensedBackground::Refine(const LensingCamera& camera){
+    LensingCamera pixelCamera = camera;
+    pixelCamera.width = width;
+    pixelCamera.height = height;
+
+    int traced = 0;
+    size_t skipped = 0; // guards against a stale pendingPixels count
+    while (traced < pixelBudget && pendingPixels > 0 && skipped < order.size()) {
+        unsigned int index = order[cursor];
+        cursor = (cursor + 1) % order.size();
+
+        unsigned char& count = samples[index];
+        if (count >= samplesPerPixel) {
+            ++skipped;
+            continue;
+        }
+        skipped = 0;
+
+        glm::vec2 jitter = LensingTracer::SampleOffset(count);
+        int x = static_cast<int>(index % width);
+        int y = static_cast<int>(index / width);
+        glm::vec3 c = tracer.Shade(pixelCamera, x + jitter.x, y + jitter.y);
+
+        // Running mean of the samples, shown over what is left of the history
+        sampleMean[index] = (count == 0) ? c : sampleMean[index] + (c - sampleMean[index]) / float(count + 1);
+        ++count;
+        float w = remainingHistory(index);
+        color[index] = (w * history[index] + float(count) * sampleMean[index]) / (w + float(count));
+        if (count >= samplesPerPixel) --pendingPixels;
+
+        ++traced;
+    }
+
+    if (traced > 0) dirty = true;
+}
+
+float LensedBackground::remainingHistory(size_t index) const{
+    float left = 1.0f - float(samples[index]) / float(samplesPerPixel);
+    return historyWeight[index] * std::max(0.0f, left);
+}
+
+void LensedBackground::Draw(){
+    // Sky sits behind everything: no depth test or write
+    glDisable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+
+    glUseProgram(shader);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    GLint skyLocation = glGetUniformLocation(shader, "sky");
+    glUniform1i(skyLocation, 0);
+
+    glBindVertexArray(VAO);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glDepthMask(GL_TRUE);
+    glEnable(GL_DEPTH_TEST);
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "config.h"
+#include "LensingTracer.h"
+
+// Per-pixel lensed sky behind the scene.
+// Every pixel is a backward geodesic traced on the CPU. A history buffer is
+// reprojected when the camera moves and only pixelBudget samples are traced
+// per frame, in a Bayer (ordered dither) order so partial passes stay evenly
+// spread. The reprojected color stays in the pixel, weighted like
+// historySamples samples, and fades out linearly as new samples arrive, so
+// moving views stay smooth and a converged pixel holds new samples only.
+// Once every pixel holds samplesPerPixel samples the image is converged and
+// nothing is traced until the camera moves again.
+struct LensedBackground{
+    int width, height;          // trace resolution, upscaled to the viewport
+    int samplesPerPixel = 4;    // jittered samples averaged per pixel when converged
+    int pixelBudget = 2000;     // samples traced per frame
+    float historySamples = 2.0f; // weight of the reprojected history, in samples; 0 drops it
+
+    LensingTracer tracer;
+
+    // Shown color, and the number of samples traced into each pixel since the
+    // camera last moved
+    std::vector<glm::vec3> color;
+    std::vector<unsigned char> samples;
+    // Mean of those samples, and the reprojected history with its weight
+    std::vector<glm::vec3> sampleMean, history;
+    std::vector<float> historyWeight;
+
+    // Pixel indices in refinement order and where the next frame resumes
+    std::vector<unsigned int> order;
+    size_t cursor = 0;
+    size_t pendingPixels = 0;   // pixels still below samplesPerPixel
+
+    glm::mat4 prevViewProjection = glm::mat4(1.0f);
+    bool hasHistory = false;
+    bool dirty = false;         // texture out of date
+
+    GLuint texture, VAO, VBO;
+    GLuint shader;
+
+    LensedBackground(int w, int h, double r_s_screen);
+    ~LensedBackground();
+
+    // Reproject the history if the camera moved, then spend the frame budget
+    void Update(const LensingCamera& camera, const glm::mat4& projection);
+    void Draw();
+
+private:
+    void SetupMesh();
+    void BuildRefinementOrder();
+    void Reproject(const LensingCamera& camera);
+    void Refine(const LensingCamera& camera);
+    // Weight the history of pixel index still has, given its samples
+    float remainingHistory(size_t index) const;
+};
@@ -0,0 +1,346 @@
+#include "LensingTracer.h"
+#include "Ray.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+
+LensingCamera LensingCamera::Orbit(float radius, float azimuth, float elevation,
+                                   float fovY, float aspect, int width, int height){
+    // Build camera position from spherical coords
+    float x = radius * cosf(elevation) * sinf(azimuth);
+    float y = radius * sinf(elevation);
+    float z = radius * cosf(elevation) * cosf(azimuth);
+    glm::vec3 position(x, y, z);
+
+    glm::mat4 view = glm::lookAt(position, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    return LensingCamera{ position, view, fovY, aspect, width, height };
+}
+
+glm::vec3 LensingTracer::PixelDirection(const LensingCamera& camera, float px, float py) const{
+    // Camera space direction through the pixel, then rotate into world space
+    float tanHalf = tanf(camera.fovY * 0.5f);
+    float ndcX = 2.0f * px / camera.width - 1.0f;
+    float ndcY = 2.0f * py / camera.height - 1.0f;
+    glm::vec3 camDir(ndcX * tanHalf * camera.aspect, ndcY * tanHalf, -1.0f);
+
+    glm::mat3 camToWorld = glm::transpose(glm::mat3(camera.view));
+    return glm::normalize(camToWorld * camDir);
+}
+
+void LensingTracer::PixelDifferentials(const LensingCamera& camera, float px, float py,
+                                       glm::vec3& dDirdx, glm::vec3& dDirdy) const{
+    float tanHalf = tanf(camera.fovY * 0.5f);
+    float ndcX = 2.0f * px / camera.width - 1.0f;
+    float ndcY = 2.0f * py / camera.height - 1.0f;
+    glm::mat3 camToWorld = glm::transpose(glm::mat3(camera.view));
+    glm::vec3 v = camToWorld * glm::vec3(ndcX * tanHalf * camera.aspect, ndcY * tanHalf, -1.0f);
+    glm::vec3 dvdx = camToWorld * glm::vec3(2.0f * tanHalf * camera.aspect / camera.width, 0.0f, 0.0f);
+    glm::vec3 dvdy = camToWorld * glm::vec3(0.0f, 2.0f * tanHalf / camera.height, 0.0f);
+
+    // d(v/|v|) = (dv - u (u.dv)) / |v|
+    float len = glm::length(v);
+    glm::vec3 u = v / len;
+    dDirdx = (dvdx - u * glm::dot(u, dvdx)) / len;
+    dDirdy = (dvdy - u * glm::dot(u, dvdy)) / len;
+}
+
+// Planar basis and initial state (r, phi, dr, dphi) for a ray leaving origin
+// along dir, built the same way as in the Ray constructor. Radial rays are
+// resolved on the spot and return false.
+static bool setupPlane(glm::vec3 origin, glm::vec3 dir, glm::vec3& basis_r, glm::vec3& basis_phi,
+                       double y[4], TraceResult& result){
+    result = TraceResult{ false, dir, 0 };
+
+    double r0 = glm::length(origin);
+    basis_r = r0 > 0.0 ? glm::normalize(origin) : glm::vec3(1.0f, 0.0f, 0.0f);
+    glm::vec3 plane_normal = glm::cross(origin, dir);
+    if (glm::length(plane_normal) < 1e-8f) {
+        // Radial ray: no bending, it either falls in or escapes straight
+        result.captured = glm::dot(dir, basis_r) < 0.0f;
+        return false;
+    }
+    plane_normal = glm::normalize(plane_normal);
+    basis_phi = glm::normalize(glm::cross(plane_normal, basis_r));
+
+    y[0] = r0;
+    y[1] = 0.0;
+    y[2] = glm::dot(dir, basis_r);
+    y[3] = glm::dot(dir, basis_phi) / r0;
+    return true;
+}
+
+// Direction of travel at state y
+static glm::vec3 travelDirection(const double y[4], glm::vec3 basis_r, glm::vec3 basis_phi, glm::vec3 fallback){
+    double cp = cos(y[1]), sp = sin(y[1]);
+    glm::vec3 radial_dir = static_cast<float>(cp) * basis_r + static_cast<float>(sp) * basis_phi;
+    glm::vec3 tangential_dir = static_cast<float>(-sp) * basis_r + static_cast<float>(cp) * basis_phi;
+    glm::vec3 out = static_cast<float>(y[2]) * radial_dir + static_cast<float>(y[0] * y[3]) * tangential_dir;
+    return glm::length(out) > 0.0f ? glm::normalize(out) : fallback;
+}
+
+TraceResult LensingTracer::Trace(glm::vec3 origin, glm::vec3 dir) const{
+    TraceResult result;
+    glm::vec3 basis_r, basis_phi;
+    double y[4];
+    if (!setupPlane(origin, dir, basis_r, basis_phi, y, result)) return result;
+
+    const double E = 1.0;
+    double freeRadius = std::max(escapeRadius, y[0]);
+
+    for (; result.steps < maxSteps; ++result.steps) {
+        if (y[0] <= r_s * 1.05) {
+            result.captured = true;
+            return result;
+        }
+        if (y[0] >= freeRadius && y[2] > 0.0) break;
+
+        Ray::rk4Step(y, E, stepScale * y[0], r_s);
+    }
+
+    result.direction = travelDirection(y, basis_r, basis_phi, dir);
+    return result;
+}
+
+TraceResult LensingTracer::TraceDifferential(glm::vec3 origin, glm::vec3 dir,
+                                             glm::vec3 dDirdx, glm::vec3 dDirdy) const{
+    TraceResult result;
+    glm::vec3 basis_r, basis_phi;
+    double y[4];
+    if (!setupPlane(origin, dir, basis_r, basis_phi, y, result)) {
+        result.dDirdx = dDirdx;
+        result.dDirdy = dDirdy;
+        return result;
+    }
+    glm::vec3 plane_normal = glm::cross(basis_r, basis_phi);
+
+    // Split each differential into an in-plane part, which seeds a deviation
+    // field, and an out-of-plane part, which rotates the plane about basis_r.
+    // Rotating dir by eps about basis_r moves it by eps * (dir . basis_phi) along the normal.
+    double dirPhi = glm::dot(dir, basis_phi);
+    glm::vec3 dDir[2] = { dDirdx, dDirdy };
+    double J[2][4];
+    double tilt[2];
+    for (int n = 0; n < 2; n++) {
+        J[n][0] = 0.0;
+        J[n][1] = 0.0;
+        J[n][2] = glm::dot(dDir[n], basis_r);
+        J[n][3] = glm::dot(dDir[n], basis_phi) / y[0];
+        tilt[n] = glm::dot(dDir[n], plane_normal) / dirPhi;
+    }
+
+    const double E = 1.0;
+    double freeRadius = std::max(escapeRadius, y[0]);
+
+    for (; result.steps < maxSteps; ++result.steps) {
+        if (y[0] <= r_s * 1.05) {
+            result.captured = true;
+            return result;
+        }
+        if (y[0] >= freeRadius && y[2] > 0.0) break;
+
+        Ray::rk4StepDeviation(y, J, E, stepScale * y[0], r_s);
+    }
+
+    // Escape direction D = v/|v| with v = dr e_r(phi) + r dphi e_phi(phi)
+    double cp = cos(y[1]), sp = sin(y[1]);
+    glm::vec3 e_r = static_cast<float>(cp) * basis_r + static_cast<float>(sp) * basis_phi;
+    glm::vec3 e_phi = static_cast<float>(-sp) * basis_r + static_cast<float>(cp) * basis_phi;
+    glm::vec3 v = static_cast<float>(y[2]) * e_r + static_cast<float>(y[0] * y[3]) * e_phi;
+    float len = glm::length(v);
+    if (len <= 0.0f) return result;
+    glm::vec3 D = v / len;
+    result.direction = D;
+
+    glm::vec3 dD[2];
+    for (int n = 0; n < 2; n++) {
+        // dv from the deviation field; e_r and e_phi turn with phi
+        const double* j = J[n];
+        glm::vec3 dv = static_cast<float>(j[2] - y[0] * y[3] * j[1]) * e_r
+                     + static_cast<float>(y[2] * j[1] + j[0] * y[3] + y[0] * j[3]) * e_phi;
+        glm::vec3 inPlane = (dv - D * glm::dot(D, dv)) / len;
+        glm::vec3 outOfPlane = static_cast<float>(tilt[n]) * glm::cross(basis_r, D);
+        dD[n] = inPlane + outOfPlane;
+    }
+    result.dDirdx = dD[0];
+    result.dDirdy = dD[1];
+
+    // Ratio of the solid angle a pixel covers on the camera side to the one
+    // it covers on the sky; the sign tracks the orientation
+    glm::vec3 imageArea = glm::cross(dDirdx, dDirdy);
+    glm::vec3 skyArea = glm::cross(dD[0], dD[1]);
+    double sky = glm::dot(skyArea, D);
+    if (std::abs(sky) > 0.0) {
+        result.magnification = glm::dot(imageArea, dir) / sky;
+    }
+    return result;
+}
+
+// Lane-wise Ray::geodesicRHS: the guards become selects so the loop has no
+// branches. The arithmetic is written in the same order as the scalar version.
+static inline void packetRHS(const double* r, const double* dr, const double* dphi, double E, double rs,
+                             double* k_r, double* k_phi, double* k_dr, double* k_dphi){
+    constexpr int N = LensingTracer::PacketSize;
+    for (int i = 0; i < N; i++) {
+        double f = 1.0 - rs/r[i];
+        bool valid = r[i] > rs * 1.01 && f >= 1e-10;
+
+        double dt_dλ = E / f;
+        double d2r =
+            - (rs/(2*r[i]*r[i])) * f * (dt_dλ*dt_dλ)
+            + (rs/(2*r[i]*r[i]*f)) * (dr[i]*dr[i])
+            + (r[i] - rs) * (dphi[i]*dphi[i]);
+        double d2phi = -2.0 * dr[i] * dphi[i] / r[i];
+
+        k_r[i]    = valid ? dr[i] : 0.0;
+        k_phi[i]  = valid ? dphi[i] : 0.0;
+        k_dr[i]   = valid ? d2r : 0.0;
+        k_dphi[i] = valid ? d2phi : 0.0;
+    }
+}
+
+void LensingTracer::TracePacket(glm::vec3 origin, const glm::vec3* dirs, int count, TraceResult* results) const{
+    constexpr int N = PacketSize;
+    const double E = 1.0;
+
+    // Structure-of-arrays state, one lane per ray. Unused lanes start retired.
+    alignas(64) double r[N], phi[N], dr[N], dphi[N], h[N];
+    glm::vec3 basis_r[N], basis_phi[N];
+    bool planar[N], active[N];
+    double freeRadius = std::max(escapeRadius, static_cast<double>(glm::length(origin)));
+
+    for (int i = 0; i < N; i++) {
+        double y[4] = { 1.0, 0.0, 0.0, 0.0 };
+        planar[i] = i < count && setupPlane(origin, dirs[i], basis_r[i], basis_phi[i], y, results[i]);
+        active[i] = planar[i];
+        r[i] = y[0]; phi[i] = y[1]; dr[i] = y[2]; dphi[i] = y[3];
+    }
+
+    alignas(64) double k1[4][N], k2[4][N], k3[4][N], k4[4][N], t[4][N];
+
+    for (int step = 0; step < maxSteps; ++step) {
+        // Retire finished lanes; retired lanes keep stepping with h = 0
+        bool any = false;
+        for (int i = 0; i < N; i++) {
+            if (!active[i]) continue;
+            if (r[i] <= r_s * 1.05) {
+                results[i].captured = true;
+                active[i] = false;
+            } else if (r[i] >= freeRadius && dr[i] > 0.0) {
+                active[i] = false;
+            } else {
+                ++results[i].steps;
+                any = true;
+            }
+        }
+        if (!any) break;
+
+        for (int i = 0; i < N; i++) h[i] = active[i] ? stepScale * r[i] : 0.0;
+
+        packetRHS(r, dr, dphi, E, r_s, k1[0], k1[1], k1[2], k1[3]);
+        for (int i = 0; i < N; i++) {
+            t[0][i] = r[i] + k1[0][i] * (h[i]/2.0);
+            t[1][i] = phi[i] + k1[1][i] * (h[i]/2.0);
+            t[2][i] = dr[i] + k1[2][i] * (h[i]/2.0);
+            t[3][i] = dphi[i] + k1[3][i] * (h[i]/2.0);
+        }
+        packetRHS(t[0], t[2], t[3], E, r_s, k2[0], k2[1], k2[2], k2[3]);
+        for (int i = 0; i < N; i++) {
+            t[0][i] = r[i] + k2[0][i] * (h[i]/2.0);
+            t[1][i] = phi[i] + k2[1][i] * (h[i]/2.0);
+            t[2][i] = dr[i] + k2[2][i] * (h[i]/2.0);
+            t[3][i] = dphi[i] + k2[3][i] * (h[i]/2.0);
+        }
+        packetRHS(t[0], t[2], t[3], E, r_s, k3[0], k3[1], k3[2], k3[3]);
+        for (int i = 0; i < N; i++) {
+            t[0][i] = r[i] + k3[0][i] * h[i];
+            t[1][i] = phi[i] + k3[1][i] * h[i];
+            t[2][i] = dr[i] + k3[2][i] * h[i];
+            t[3][i] = dphi[i] + k3[3][i] * h[i];
+        }
+        packetRHS(t[0], t[2], t[3], E, r_s, k4[0], k4[1], k4[2], k4[3]);
+        for (int i = 0; i < N; i++) {
+            r[i]    += (h[i]/6.0)*(k1[0][i] + 2*k2[0][i] + 2*k3[0][i] + k4[0][i]);
+            phi[i]  += (h[i]/6.0)*(k1[1][i] + 2*k2[1][i] + 2*k3[1][i] + k4[1][i]);
+            dr[i]   += (h[i]/6.0)*(k1[2][i] + 2*k2[2][i] + 2*k3[2][i] + k4[2][i]);
+            dphi[i] += (h[i]/6.0)*(k1[3][i] + 2*k2[3][i] + 2*k3[3][i] + k4[3][i]);
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (!planar[i] || results[i].captured) continue;
+        double y[4] = { r[i], phi[i], dr[i], dphi[i] };
+        results[i].direction = travelDirection(y, basis_r[i], basis_phi[i], dirs[i]);
+    }
+}
+
+glm::vec3 LensingTracer::Shade(const LensingCamera& camera, float px, float py) const{
+    return Shade(Trace(camera.position, PixelDirection(camera, px, py)));
+}
+
+glm::vec3 LensingTracer::Shade(const TraceResult& hit){
+    if (hit.captured) return glm::vec3(0.0f);
+    return Background(hit.direction);
+}
+
+glm::vec2 LensingTracer::SampleOffset(int n){
+    return glm::vec2(fmodf(0.5f + n * 0.7548776662f, 1.0f),
+                     fmodf(0.5f + n * 0.5698402910f, 1.0f));
+}
+// Sky: checkerboard of 15 degree cells, which makes the distortion easy to
+// read, plus sparse stars on a 1 degree grid
+static const float skyCell = 3.14159265f / 12.0f;
+static const float starCell = 3.14159265f / 180.0f;
+static const glm::vec3 skyEven(0.10f, 0.08f, 0.20f);
+static const glm::vec3 skyOdd(0.04f, 0.05f, 0.12f);
+
+// Brightness of the star in the star cell containing (lon, lat), 0 if empty
+static float starBrightness(float lon, float lat){
+    // Hash the cell and light up a few of them
+    unsigned int su = static_cast<unsigned int>(static_cast<int>(floorf(lon / starCell)) + 1000);
+    unsigned int sv = static_cast<unsigned int>(static_cast<int>(floorf(lat / starCell)) + 1000);
+    unsigned int h = su * 73856093u ^ sv * 19349663u;
+    h ^= h >> 13; h *= 0x5bd1e995u; h ^= h >> 15;
+    if ((h & 1023u) >= 6u) return 0.0f;
+    return 0.6f + 0.4f * static_cast<float>((h >> 10) & 255u) / 255.0f;
+}
+
+glm::vec3 LensingTracer::Background(glm::vec3 dir){
+    float lon = atan2f(dir.z, dir.x);                       // -pi..pi
+    float lat = asinf(glm::clamp(dir.y, -1.0f, 1.0f));      // -pi/2..pi/2
+
+    float star = starBrightness(lon, lat);
+    if (star > 0.0f) return glm::vec3(star);
+
+    int cu = static_cast<int>(floorf(lon / skyCell));
+    int cv = static_cast<int>(floorf(lat / skyCell));
+    return ((cu + cv) & 1) ? skyOdd : skyEven;
+}
+
+glm::vec3 LensingTracer::Background(glm::vec3 dir, glm::vec3 dDirdx, glm::vec3 dDirdy){
+    float lon = atan2f(dir.z, dir.x);
+    float lat = asinf(glm::clamp(dir.y, -1.0f, 1.0f));
+
+    // Footprint in longitude/latitude, from the derivatives of atan2 and asin
+    float xz = std::max(dir.x * dir.x + dir.z * dir.z, 1e-8f);
+    float cosLat = sqrtf(xz);
+    float widthLon = std::abs((dir.x * dDirdx.z - dir.z * dDirdx.x) / xz)
+                   + std::abs((dir.x * dDirdy.z - dir.z * dDirdy.x) / xz);
+    float widthLat = std::abs(dDirdx.y / cosLat) + std::abs(dDirdy.y / cosLat);
+
+    // Box filtered checkerboard: average of the +-1 square wave over the footprint
+    auto boxedSign = [](float p, float w){
+        w = std::max(w, 1e-4f);
+        auto tri = [](float x){ return std::abs(x * 0.5f - floorf(x * 0.5f) - 0.5f); };
+        return glm::clamp(2.0f * (tri(p - 0.5f * w) - tri(p + 0.5f * w)) / w, -1.0f, 1.0f);
+    };
+    float odd = 0.5f - 0.5f * boxedSign(lon / skyCell, widthLon / skyCell) * boxedSign(lat / skyCell, widthLat / skyCell);
+    glm::vec3 color = glm::mix(skyEven, skyOdd, odd);
+
+    // A star smaller than the footprint only covers part of the pixel
+    float star = starBrightness(lon, lat);
+    if (star > 0.0f) {
+        float footprint = (widthLon / starCell) * (widthLat / starCell);
+        color = glm::mix(color, glm::vec3(star), 1.0f / std::max(1.0f, footprint));
+    }
+    return color;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <glm/glm.hpp>
+
+// Pinhole camera used to shoot one backward ray per pixel.
+// Pixel (0,0) is the bottom-left corner, matching OpenGL texture rows.
+struct LensingCamera{
+    glm::vec3 position;
+    glm::mat4 view;     // world -> camera, same matrix as the "view" uniform
+    float fovY;         // vertical field of view (radians)
+    float aspect;       // width / height of the projection
+    int width, height;  // image resolution in pixels
+
+    // Orbit camera looking at the origin, as driven by the mouse in App
+    static LensingCamera Orbit(float radius, float azimuth, float elevation,
+                               float fovY, float aspect, int width, int height);
+};
+
+// Outcome of following one backward geodesic from the camera
+struct TraceResult{
+    bool captured;       // ray crossed the horizon stopping radius
+    glm::vec3 direction; // asymptotic direction of escape (unit vector)
+    int steps;           // integration steps taken
+
+    // Filled by TraceDifferential only: change of the escape direction per
+    // pixel step in x and y (the pixel footprint on the sky) and the signed
+    // magnification, negative for parity-flipped images
+    glm::vec3 dDirdx = glm::vec3(0.0f);
+    glm::vec3 dDirdy = glm::vec3(0.0f);
+    double magnification = 1.0;
+};
+
+// Traces Schwarzschild null geodesics from the camera with the Ray integrator
+// and shades them with a procedural celestial sphere.
+struct LensingTracer{
+    double r_s;                  // Schwarzschild radius in screen units
+    double escapeRadius = 40.0;  // rays moving outwards beyond this are considered free
+    double stepScale = 0.05;     // affine step is stepScale * r, so far-away steps are larger
+    int maxSteps = 4000;
+
+    // Rays integrated side by side by TracePacket
+    static constexpr int PacketSize = 8;
+
+    LensingTracer(double r_s_screen) : r_s(r_s_screen) {}
+
+    // World space direction through image position (px, py), in pixels
+    glm::vec3 PixelDirection(const LensingCamera& camera, float px, float py) const;
+
+    // Integrate the geodesic starting at origin with initial direction dir
+    TraceResult Trace(glm::vec3 origin, glm::vec3 dir) const;
+
+    // Trace plus ray differentials. dDirdx/dDirdy are the derivatives of the
+    // initial direction with respect to the pixel coordinates. In-plane changes
+    // are carried by geodesic deviation fields integrated next to the ray;
+    // out-of-plane changes tilt the orbital plane about the hole-camera axis,
+    // which spherical symmetry lets us apply exactly at the end.
+    TraceResult TraceDifferential(glm::vec3 origin, glm::vec3 dir, glm::vec3 dDirdx, glm::vec3 dDirdy) const;
+
+    // Derivatives of PixelDirection with respect to px and py
+    void PixelDifferentials(const LensingCamera& camera, float px, float py, glm::vec3& dDirdx, glm::vec3& dDirdy) const;
+
+    // Same as Trace for up to PacketSize rays sharing an origin. The state is
+    // kept as structure-of-arrays and all lanes step together so the inner
+    // loops vectorize; results are identical to calling Trace per ray.
+    void TracePacket(glm::vec3 origin, const glm::vec3* dirs, int count, TraceResult* results) const;
+
+    // Color seen through image position (px, py)
+    glm::vec3 Shade(const LensingCamera& camera, float px, float py) const;
+
+    // Color for a finished trace
+    static glm::vec3 Shade(const TraceResult& hit);
+
+    // Color of the (unlensed) sky in direction dir
+    static glm::vec3 Background(glm::vec3 dir);
+
+    // Sky averaged over the footprint spanned by dDirdx and dDirdy, so one ray
+    // per pixel does not alias where the lens compresses the background
+    static glm::vec3 Background(glm::vec3 dir, glm::vec3 dDirdx, glm::vec3 dDirdy);
+
+    // Sub-pixel offset of jittered sample n (R2 sequence); sample 0 is the pixel center
+    static glm::vec2 SampleOffset(int n);
+};
@@ -0,0 +1,86 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+// Static, spherically symmetric spacetimes ds² = -f dt² + dr²/f + r² dΩ² as
+// compile-time policies for the ray integrators. A policy exposes f(r), its
+// derivative f'(r) and the (outer) black hole horizon; the templated right
+// hand sides in Ray inline them, so each spacetime gets its own integrator
+// with no virtual calls or branches on the spacetime inside a step. Lengths
+// are in screen units, like everything Ray integrates.
+
+enum class Spacetime {
+    Schwarzschild,          // f = 1 - rs/r
+    ReissnerNordstrom,      // f = 1 - rs/r + rq²/r², electrically charged
+    SchwarzschildDeSitter,  // f = 1 - rs/r - Λr²/3, positive cosmological constant
+};
+
+struct Schwarzschild{
+    double rs;
+    double horizon;
+
+    explicit Schwarzschild(double rs) : rs(rs), horizon(rs) {}
+
+    double f(double r) const { return 1.0 - rs / r; }
+    double df(double r) const { return rs / (r * r); }
+};
+
+struct ReissnerNordstrom{
+    double rs;
+    double rq2;         // rq² = G Q² / (4π ε0 c⁴); horizons need rq <= rs/2
+    double horizon;     // outer horizon r+
+
+    ReissnerNordstrom(double rs, double rq)
+        : rs(rs), rq2(rq * rq), horizon(0.5 * (rs + std::sqrt(std::max(0.0, rs * rs - 4.0 * rq * rq)))) {}
+
+    double f(double r) const { return 1.0 - rs / r + rq2 / (r * r); }
+    double df(double r) const { return rs / (r * r) - 2.0 * rq2 / (r * r * r); }
+};
+
+struct SchwarzschildDeSitter{
+    double rs;
+    double lambda;      // Λ; a black hole horizon needs Λ rs² < 4/27
+    double horizon;     // black hole horizon, the smaller positive root of f
+
+    SchwarzschildDeSitter(double rs, double lambda) : rs(rs), lambda(lambda), horizon(rs){
+        // r f(r) = r - rs - Λr³/3 rises through zero at the black hole
+        // horizon; Newton from rs approaches it from below
+        for (int i = 0; i < 32; ++i) {
+            double g = horizon - rs - lambda * horizon * horizon * horizon / 3.0;
+            double dg = 1.0 - lambda * horizon * horizon;
+            if (dg <= 0.0 || std::abs(g) <= 1e-15 * rs) break;
+            horizon -= g / dg;
+        }
+    }
+
+    double f(double r) const { return 1.0 - rs / r - lambda * r * r / 3.0; }
+    double df(double r) const { return rs / (r * r) - 2.0 * lambda * r / 3.0; }
+};
+
+inline const std::vector<Spacetime>& Spacetimes(){
+    static const std::vector<Spacetime> all = {
+        Spacetime::Schwarzschild, Spacetime::ReissnerNordstrom, Spacetime::SchwarzschildDeSitter };
+    return all;
+}
+
+// Command line names ("schwarzschild", ...). Parse returns false for unknown names.
+inline const char* SpacetimeName(Spacetime spacetime){
+    switch (spacetime) {
+    case Spacetime::Schwarzschild: return "schwarzschild";
+    case Spacetime::ReissnerNordstrom: return "reissner-nordstrom";
+    case Spacetime::SchwarzschildDeSitter: return "schwarzschild-de-sitter";
+    }
+    return "unknown";
+}
+
+inline bool ParseSpacetime(const std::string& name, Spacetime& spacetime){
+    for (Spacetime s : Spacetimes()) {
+        if (name == SpacetimeName(s)) {
+            spacetime = s;
+            return true;
+        }
+    }
+    return false;
+}
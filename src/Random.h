@@ -0,0 +1,170 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Random and quasi-random numbers addressed by index rather than drawn from
+// a shared state. Every value is a pure function of (seed, index, dimension),
+// so workers can initialize any ray or particle independently, in any order,
+// and a run is reproducible from its seed alone.
+
+// Philox4x32-10 (Salmon et al. 2011): a keyed bijection of a 128 bit counter.
+// Ten rounds of two 32x32->64 multiplies pass BigCrush for any counter/key.
+inline std::array<uint32_t, 4> Philox4x32(std::array<uint32_t, 4> ctr, std::array<uint32_t, 2> key){
+    for (int round = 0; round < 10; ++round) {
+        uint64_t p0 = uint64_t(0xD2511F53u) * ctr[0];
+        uint64_t p1 = uint64_t(0xCD9E8D57u) * ctr[2];
+        ctr = { uint32_t(p1 >> 32) ^ ctr[1] ^ key[0], uint32_t(p1),
+                uint32_t(p0 >> 32) ^ ctr[3] ^ key[1], uint32_t(p0) };
+        key[0] += 0x9E3779B9u;
+        key[1] += 0xBB67AE85u;
+    }
+    return ctr;
+}
+
+// The last counter word of every Philox call names the family of numbers it
+// feeds, so families never share a counter whatever their indices: emitter
+// samples, the quasi-random shifts, and each CounterRng user.
+enum class RandomDomain : uint32_t {
+    Samples = 0,    // RandomUniform: ray emission
+    Shifts,         // Halton and Sobol randomization
+    Lenses,         // point lens placement
+    Particles,      // particle swarm spawns
+};
+
+// Uniform in [0, 1) from two 32 bit words (53 bits used)
+inline double UnitDouble(uint32_t hi, uint32_t lo){
+    return double(((uint64_t(hi) << 32) | lo) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Independent uniform in [0, 1) for (seed, index, dimension)
+inline double RandomUniform(uint64_t seed, uint64_t index, uint32_t dimension){
+    auto x = Philox4x32({ uint32_t(index), uint32_t(index >> 32), dimension, uint32_t(RandomDomain::Samples) },
+                        { uint32_t(seed), uint32_t(seed >> 32) });
+    return UnitDouble(x[0], x[1]);
+}
+
+// A stream of uniforms for one object: stream selects the object within
+// domain, and successive calls walk the counter (2^32 blocks per stream).
+// Four words per Philox call, two per value.
+struct CounterRng{
+    CounterRng(uint64_t seed, RandomDomain domain, uint64_t stream)
+        : key{ uint32_t(seed), uint32_t(seed >> 32) }, domain(domain), stream(stream) {}
+
+    double Uniform(){
+        if (used == 4) {
+            words = Philox4x32({ block, uint32_t(stream), uint32_t(stream >> 32), uint32_t(domain) }, key);
+            ++block;
+            used = 0;
+        }
+        used += 2;
+        return UnitDouble(words[used - 2], words[used - 1]);
+    }
+
+private:
+    std::array<uint32_t, 2> key;
+    RandomDomain domain;
+    uint64_t stream;
+    uint32_t block = 0;
+    std::array<uint32_t, 4> words{};
+    int used = 4;
+};
+
+// Per-dimension random words for randomizing a sequence; which selects the
+// sequence, so Halton and Sobol shifts are unrelated
+inline std::array<uint32_t, 4> SequenceShift(uint64_t seed, uint32_t which, uint32_t dimension){
+    return Philox4x32({ dimension, which, 0u, uint32_t(RandomDomain::Shifts) }, { uint32_t(seed), uint32_t(seed >> 32) });
+}
+
+// Halton: radical inverse of index + 1 in the dimension-th prime base,
+// randomized by a per-dimension toroidal shift (Cranley-Patterson rotation)
+inline double Halton(uint64_t index, uint32_t dimension, uint64_t seed){
+    static const uint32_t primes[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53 };
+    uint32_t base = primes[dimension % 16];
+    double inverse = 0.0, digit = 1.0 / base;
+    for (uint64_t n = index + 1; n > 0; n /= base, digit /= base) inverse += double(n % base) * digit;
+    auto shift = SequenceShift(seed, 0u, dimension);
+    double x = inverse + UnitDouble(shift[0], shift[1]);
+    return x < 1.0 ? x : x - 1.0;
+}
+
+// Sobol in up to 7 dimensions (Joe-Kuo direction numbers), randomized by a
+// per-dimension digital shift. Any prefix of 2^m points puts exactly one
+// point in each of the 2^m equal intervals of every dimension.
+inline double Sobol(uint64_t index, uint32_t dimension, uint64_t seed){
+    // Degree s, coefficients a and initial m of each primitive polynomial;
+    // dimension 0 is the van der Corput sequence
+    static const std::array<std::array<uint32_t, 32>, 7> directions = []{
+        struct Polynomial{ uint32_t s, a; uint32_t m[4]; };
+        const Polynomial polynomials[6] = {
+            { 1, 0, { 1 } }, { 2, 1, { 1, 3 } }, { 3, 1, { 1, 3, 1 } },
+            { 3, 2, { 1, 1, 1 } }, { 4, 1, { 1, 1, 3, 3 } }, { 4, 4, { 1, 3, 5, 13 } } };
+        std::array<std::array<uint32_t, 32>, 7> v{};
+        for (int k = 0; k < 32; ++k) v[0][k] = 1u << (31 - k);
+        for (int d = 1; d < 7; ++d) {
+            const Polynomial& p = polynomials[d - 1];
+            for (uint32_t k = 0; k < 32; ++k) {
+                if (k < p.s) {
+                    v[d][k] = p.m[k] << (31 - k);
+                    continue;
+                }
+                uint32_t x = v[d][k - p.s] ^ (v[d][k - p.s] >> p.s);
+                for (uint32_t j = 1; j < p.s; ++j) {
+                    if ((p.a >> (p.s - 1 - j)) & 1u) x ^= v[d][k - j];
+                }
+                v[d][k] = x;
+            }
+        }
+        return v;
+    }();
+
+    const auto& v = directions[dimension % 7];
+    uint32_t x = 0;
+    for (int k = 0; index != 0 && k < 32; ++k, index >>= 1) {
+        if (index & 1) x ^= v[k];
+    }
+    auto shift = SequenceShift(seed, 1u, dimension);
+    return double(x ^ shift[0]) * (1.0 / 4294967296.0);
+}
+
+// How emitters place their samples
+enum class Sampling {
+    Random,     // Philox, independent per ray
+    Halton,     // low discrepancy, any count
+    Sobol,      // low discrepancy, best stratified at powers of two
+};
+
+inline double Sample(Sampling sampling, uint64_t seed, uint64_t index, uint32_t dimension){
+    switch (sampling) {
+    case Sampling::Halton: return Halton(index, dimension, seed);
+    case Sampling::Sobol: return Sobol(index, dimension, seed);
+    case Sampling::Random: break;
+    }
+    return RandomUniform(seed, index, dimension);
+}
+
+inline const std::vector<Sampling>& Samplings(){
+    static const std::vector<Sampling> all = { Sampling::Random, Sampling::Halton, Sampling::Sobol };
+    return all;
+}
+
+// Command line names ("random", ...). Parse returns false for unknown names.
+inline const char* SamplingName(Sampling sampling){
+    switch (sampling) {
+    case Sampling::Random: return "random";
+    case Sampling::Halton: return "halton";
+    case Sampling::Sobol: return "sobol";
+    }
+    return "unknown";
+}
+
+inline bool ParseSampling(const std::string& name, Sampling& sampling){
+    for (Sampling s : Samplings()) {
+        if (name == SamplingName(s)) {
+            sampling = s;
+            return true;
+        }
+    }
+    return false;
+}
@@ -1,7 +1,25 @@
 #include "Ray.h"
-#include "view/shader.h" 
-#include "config.h"
+#include <algorithm>
 #include <cmath>
+#include <limits>
+#include <type_traits>
+
+// The one place the runtime choice of spacetime becomes a policy type: fn is
+// called with the metric for options.spacetime around a black hole of rs
+template <class Fn>
+static void withMetric(const StepOptions& options, double rs, Fn&& fn){
+    switch (options.spacetime) {
+    case Spacetime::Schwarzschild:
+        fn(Schwarzschild(rs));
+        break;
+    case Spacetime::ReissnerNordstrom:
+        fn(ReissnerNordstrom(rs, options.charge * rs));
+        break;
+    case Spacetime::SchwarzschildDeSitter:
+        fn(SchwarzschildDeSitter(rs, options.cosmologicalConstant / (rs * rs)));
+        break;
+    }
+}
 
 Ray::Ray(glm::vec3 pos, glm::vec3 dir) : position(pos), dir(dir){
     // Initial radial distance
@@ -11,16 +29,17 @@ Ray::Ray(glm::vec3 pos, glm::vec3 dir) : position(pos), dir(dir){
 
     // Build orthonormal basis for the plane containing the motion.
     // e_r points from origin to the initial position.
+    glm::dvec3 p(position), v(dir);
     if (r > 0.0) {
-        basis_r = glm::normalize(position);
+        basis_r = p / r;
     } else {
-        basis_r = glm::vec3(1.0f, 0.0f, 0.0f);
+        basis_r = glm::dvec3(1.0, 0.0, 0.0);
     }
 
     // plane normal is cross(position, dir). If nearly zero, pick z axis.
-    plane_normal = glm::cross(position, dir);
-    if (glm::length(plane_normal) < 1e-8f) {
-        plane_normal = glm::vec3(0.0f, 0.0f, 1.0f);
+    plane_normal = glm::cross(p, v);
+    if (glm::length(plane_normal) < 1e-8) {
+        plane_normal = glm::dvec3(0.0, 0.0, 1.0);
     } else {
         plane_normal = glm::normalize(plane_normal);
     }
@@ -29,96 +48,269 @@ Ray::Ray(glm::vec3 pos, glm::vec3 dir) : position(pos), dir(dir){
     basis_phi = glm::normalize(glm::cross(plane_normal, basis_r));
 
     // Project velocity into this local plane basis to get dr and dphi
-    dr = glm::dot(dir, basis_r);
+    dr = glm::dot(v, basis_r);
     if (r > 0.0) {
-        dphi = glm::dot(dir, basis_phi) / r;
+        dphi = glm::dot(v, basis_phi) / r;
     } else {
         dphi = 0.0;
     }
 
     E = 1.0;
+    L = r * r * dphi;
+    initialHeading = std::atan2(r * dphi, dr);
 
     // Start trail (store xyz + alpha in w)
     trail.push_back(glm::vec4(position, 1.0f));
+}
+
+bool Ray::Step(double dLambda, double r_s_meters, const StepOptions& options){
+    if (!Integrate(dLambda, r_s_meters, options)) return false;
+
+    // No trail kept (density and statistics runs): skip the bookkeeping
+    if (maxTrailLength == 0) {
+        trail.clear();
+        return true;
+    }
 
-    model = glm::translate(glm::mat4(1.0f), position);
-    SetupMesh();
+    // Update trail (store alpha in w)
+    if (options.trailSpacing > 0.0) {
+        // Sample the step at every trail time it covers, whatever its length
+        EmitTrail(lambda, options.trailSpacing);
+        return true;
+    }
+    trail.push_back(glm::vec4(position, 1.0f)); // Update trail after position update
+    trimTrail();
+    return true;
 }
 
-void Ray::SetupMesh(){
-    // --- Setup point ---
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
+bool Ray::Integrate(double dLambda, double r_s_meters, const StepOptions& options){
+    // Convert Schwarzschild radius to screen coordinates
+    meters_per_screen_unit = (r_s_meters * simulation_scale_factor) / 6;
+    double r_s_screen = ScreenSchwarzschildRadius(r_s_meters);
+
+    if (options.spin != 0.0) return integrateKerr(dLambda, r_s_screen, options);
+
+    // r is kept in double precision between steps; re-deriving it from the
+    // float position every step fed rounding noise straight into the state
+    // Stop if inside the event horizon
+    double horizon = r_s_screen, f = 1.0;
+    withMetric(options, r_s_screen, [&](const auto& metric){
+        horizon = metric.horizon;
+        f = metric.f(r);
+    });
+    double captureRadius = options.regularizeHorizon ? horizon : horizon * 1.05;
+    if (captured || r <= captureRadius) {
+        captured = true;
+        return false;
+    }
 
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    if (!invariantsSet) {
+        L = r * r * dphi;
+        E = sqrt(dr * dr + f * L * L / (r * r));
+        invariantsSet = true;
+    }
 
-    // Initially with a single point
-    glm::vec4 point = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4), &point, GL_DYNAMIC_DRAW);
+    //calculateSchwarzschildGeodesic;
+    stepStart[0] = r; stepStart[1] = phi; stepStart[2] = dr; stepStart[3] = dphi;
+    double y[4] = { r, phi, dr, dphi };
+    Advance(options, y, E, L, dLambda, r_s_screen);
+    r = y[0]; phi = y[1]; dr = y[2]; dphi = y[3];
+    lambda += dLambda;
+    stepLength = dLambda;
 
-    // Vertex attribute 0: position
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    // Vertex attribute 3: alpha stored in w component
-    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(3);
+    
+    // Reconstruct 3D position from plane basis and updated r,phi
+    double c = cos(phi);
+    double s = sin(phi);
+    glm::dvec3 radial_dir = c * basis_r + s * basis_phi;
+    glm::dvec3 tangential_dir = -s * basis_r + c * basis_phi;
+    position = glm::vec3(r * radial_dir);
 
-    glBindVertexArray(0);
+    dir = glm::vec3(dr * radial_dir + r * dphi * tangential_dir);
 
-    // --- Setup trail ---
-    glGenVertexArrays(1, &trailVAO);
-    glGenBuffers(1, &trailVBO);
+    // normalize direction
+    if (glm::length(dir) > 0.0f) {
+        dir = glm::normalize(dir) * speed;
+    }
+    return true;
+}
 
-    glBindVertexArray(trailVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, trailVBO);
+void Ray::EmitTrail(double upTo, double spacing){
+    if (maxTrailLength == 0) {
+        trail.clear();
+        return;
+    }
+    if (stepLength <= 0.0) return;
+    double lambda0 = lambda - stepLength;
+    double end = std::min(upTo, lambda);
+
+    size_t before = trail.size();
+    if (nextTrailLambda <= lambda0) nextTrailLambda = lambda0 + spacing;
+    for (; nextTrailLambda <= end; nextTrailLambda += spacing) {
+        trail.push_back(glm::vec4(samplePosition((nextTrailLambda - lambda0) / stepLength), 1.0f));
+    }
+    if (trail.size() != before) trimTrail();
+}
 
-    // empty buffer for now, will update every frame
-    glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW);
+void Ray::SampleAt(double t){
+    if (stepLength <= 0.0 || t >= lambda) return;
+    double lambda0 = lambda - stepLength;
+    position = samplePosition(std::max(0.0, (t - lambda0) / stepLength));
+}
 
-    // Vertex attribute 0: position
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+// Partial derivatives of Cartesian (x, y, z) with respect to (r, θ, φ) for
+// x + iy = sqrt(r² + a²) sinθ e^{iφ}, z = r cosθ
+static glm::dmat3 kerrJacobian(double r, double theta, double phi, double a){
+    double rho = std::sqrt(r * r + a * a);
+    double st = std::sin(theta), ct = std::cos(theta);
+    double sp = std::sin(phi), cp = std::cos(phi);
+    return glm::dmat3(glm::dvec3(r / rho * st * cp, r / rho * st * sp, ct),
+                      glm::dvec3(rho * ct * cp, rho * ct * sp, -r * st),
+                      glm::dvec3(-rho * st * sp, rho * st * cp, 0.0));
+}
 
-    // Vertex atttribute 3: alpha
-    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(3);
+// Angle between two directions, accurate for small angles too
+static double angleBetween(glm::dvec3 a, glm::dvec3 b){
+    return std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b));
+}
 
-    glBindVertexArray(0);
+glm::dvec3 Ray::StatePosition() const{
+    if (kerrSet) {
+        double rho = std::sqrt(kerr[0] * kerr[0] + kerrConstants.a * kerrConstants.a);
+        double st = std::sin(kerr[1]);
+        return glm::dvec3(rho * st * std::cos(kerr[2]), rho * st * std::sin(kerr[2]), kerr[0] * std::cos(kerr[1]));
+    }
+    return r * (std::cos(phi) * basis_r + std::sin(phi) * basis_phi);
 }
 
-void Ray::Step(double dLambda, double r_s_meters){
-    // Convert Schwarzschild radius to screen coordinates
-    meters_per_screen_unit = (r_s_meters * simulation_scale_factor) / 6;
-    double r_s_screen = r_s_meters / meters_per_screen_unit;
+glm::dvec3 Ray::Velocity() const{
+    if (kerrSet) {
+        double dy[5];
+        kerrRHS(kerr, kerrConstants, dy);
+        return kerrJacobian(kerr[0], kerr[1], kerr[2], kerrConstants.a) * glm::dvec3(dy[0], dy[1], dy[2]);
+    }
+    double c = std::cos(phi), s = std::sin(phi);
+    glm::dvec3 radial = c * basis_r + s * basis_phi;
+    glm::dvec3 tangential = -s * basis_r + c * basis_phi;
+    return dr * radial + r * dphi * tangential;
+}
 
-    r = glm::length(position);
-    if (r <= r_s_screen * 1.05) return; // Stop if inside the event horizon
+double Ray::Deflection() const{
+    if (kerrSet) return kerrTurn;
+    return phi + std::atan2(r * dphi, dr) - initialHeading;
+}
 
-    //calculateSchwarzschildGeodesic;
-    rk4Step(*this, dLambda, r_s_screen); 
+void Ray::Deflect(glm::dvec3 deltaV, double r_s_meters, const StepOptions& options){
+    glm::dvec3 v = Velocity();
+    // Far below what the state can resolve: nothing to do, so lenses too
+    // weak to matter cost no more than the field evaluation
+    if (glm::dot(deltaV, deltaV) <= 1e-24 * glm::dot(v, v)) return;
+    if (kerrSet) {
+        deflectKerr(deltaV);
+        return;
+    }
 
-    
-    // Reconstruct 3D position from plane basis and updated r,phi
-    float cf = static_cast<float>(cos(phi));
-    float sf = static_cast<float>(sin(phi));
-    glm::vec3 radial_dir = cf * basis_r + sf * basis_phi;
-    glm::vec3 tangential_dir = -sf * basis_r + cf * basis_phi;
-    position = static_cast<float>(r) * radial_dir;
+    // Turn the plane about the current radius until it holds the new
+    // velocity; the basis turns with it so r and phi stay as they are
+    glm::dvec3 w = v + deltaV;
+    double c = std::cos(phi), s = std::sin(phi);
+    glm::dvec3 radial = c * basis_r + s * basis_phi;
+    glm::dvec3 normal = glm::cross(radial, w);
+    double n = glm::length(normal);
+    normal = n > 1e-12 * glm::length(w) ? normal / n : plane_normal;
+    glm::dvec3 tangential = glm::cross(normal, radial);
+    basis_r = c * radial - s * tangential;
+    basis_phi = s * radial + c * tangential;
+    plane_normal = normal;
+
+    double kickedDr = glm::dot(w, radial), kickedDphi = glm::dot(w, tangential) / r;
+    if (invariantsSet) {
+        // E² = dr² + f r² dphi² and L = r² dphi change by exactly the kick
+        double f = 1.0;
+        withMetric(options, ScreenSchwarzschildRadius(r_s_meters), [&](const auto& metric){ f = metric.f(r); });
+        L += r * r * (kickedDphi - dphi);
+        E = std::sqrt(std::max(0.0, E * E + kickedDr * kickedDr - dr * dr + f * r * r * (kickedDphi * kickedDphi - dphi * dphi)));
+    }
+    dr = kickedDr;
+    dphi = kickedDphi;
+    if (glm::length(w) > 0.0) dir = glm::vec3(glm::normalize(w)) * speed;
+}
 
-    dir = static_cast<float>(dr) * radial_dir + static_cast<float>(r * dphi) * tangential_dir;
+glm::vec3 Ray::samplePosition(double s) const{
+    if (!kerrSet) {
+        double y[4] = { r, phi, dr, dphi };
+        return Interpolate(stepStart, y, stepLength, s);
+    }
+    // Cubic Hermite in Cartesian coordinates between the ends of the Kerr step
+    float t = static_cast<float>(s), h = static_cast<float>(stepLength);
+    float t2 = t * t, t3 = t2 * t;
+    return (2 * t3 - 3 * t2 + 1) * kerrStartPosition + (t3 - 2 * t2 + t) * h * kerrStartVelocity +
+           (-2 * t3 + 3 * t2) * kerrEndPosition + (t3 - t2) * h * kerrEndVelocity;
+}
 
-    // normalize direction
-    if (glm::length(dir) > 0.0f) {
-        dir = glm::normalize(dir) * speed;
+bool Ray::integrateKerr(double dLambda, double r_s_screen, const StepOptions& options){
+    double M = 0.5 * r_s_screen;
+    double a = options.spin * M;
+    double rhs[5];
+    if (!kerrSet) {
+        KerrInitialState(position, dir, a, M, kerr, kerrConstants);
+        E = kerrConstants.E;
+        L = kerrConstants.Lz;
+        invariantsSet = true;
+        kerrSet = true;
+        kerrRHS(kerr, kerrConstants, rhs);
+        KerrCartesian(kerr, rhs, a, kerrEndPosition, kerrEndVelocity);
     }
 
-    // Update trail (store alpha in w)
-    trail.push_back(glm::vec4(position, 1.0f)); // Update trail after position update
+    double captureRadius = KerrHorizon(a, M) * (options.regularizeHorizon ? 1.01 : 1.05);
+    if (captured || kerr[0] <= captureRadius) {
+        captured = true;
+        return false;
+    }
 
+    kerrStartPosition = kerrEndPosition;
+    kerrStartVelocity = kerrEndVelocity;
+
+    // Boyer-Lindquist angles sweep fast for rays passing near the spin axis
+    // (dφ/dλ grows like 1/sin²θ), so the step is split until no substep
+    // turns θ or φ by more than maxAngle
+    const double maxAngle = 0.02;
+    double remaining = dLambda;
+    kerrRHS(kerr, kerrConstants, rhs);
+    glm::dvec3 velocity = kerrJacobian(kerr[0], kerr[1], kerr[2], a) * glm::dvec3(rhs[0], rhs[1], rhs[2]);
+    while (remaining > 0.0) {
+        double rate = std::max({ std::abs(rhs[1]), std::abs(rhs[2]), std::abs(rhs[0]) / kerr[0] });
+        double h = rate * remaining > maxAngle ? std::max(maxAngle / rate, 1e-4 * dLambda) : remaining;
+        h = std::min(h, remaining);
+        rk4StepKerr(kerr, kerrConstants, h);
+        if (options.projectInvariants) ProjectKerr(kerr, kerrConstants);
+        remaining -= h;
+        kerrRHS(kerr, kerrConstants, rhs);
+        // Substeps turn dir by little, so the turn sums without wrapping
+        glm::dvec3 next = kerrJacobian(kerr[0], kerr[1], kerr[2], a) * glm::dvec3(rhs[0], rhs[1], rhs[2]);
+        kerrTurn += angleBetween(velocity, next);
+        velocity = next;
+    }
+    lambda += dLambda;
+    stepLength = dLambda;
+
+    KerrCartesian(kerr, rhs, a, kerrEndPosition, kerrEndVelocity);
+    position = kerrEndPosition;
+    if (glm::length(kerrEndVelocity) > 0.0f) dir = glm::normalize(kerrEndVelocity) * speed;
+
+    // Mirror into the planar fields that escape tests and step control read
+    double sinTheta = std::sin(kerr[1]);
+    r = kerr[0];
+    phi = kerr[2];
+    dr = rhs[0];
+    dphi = std::sqrt(rhs[1] * rhs[1] + sinTheta * sinTheta * rhs[2] * rhs[2]);
+    return true;
+}
+
+void Ray::trimTrail(){
     // Limit the trail size 
     if (trail.size() > maxTrailLength) {
-        trail.erase(trail.begin());
+        trail.erase(trail.begin(), trail.begin() + (trail.size() - maxTrailLength));
     }
 
     // Update alpha values
@@ -128,65 +320,249 @@ void Ray::Step(double dLambda, double r_s_meters){
             trail[i].w = normalizedAge;
         }
     }
+}
 
-    
-    model = glm::translate(glm::mat4(1.0f), position);
-}
-
-void Ray::Draw(const std::vector<Ray>& rays, GLuint shaderProgram){
-    glUseProgram(shaderProgram);
-
-    // Turn on blending for the trails
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glLineWidth(1.0f);
-
-    for (auto& ray: rays){
-        // ---- Draw Ray trail ----
-        if (!ray.trail.empty()){
-            glBindBuffer(GL_ARRAY_BUFFER, ray.trailVBO);
-            glBufferData(GL_ARRAY_BUFFER,
-                        ray.trail.size() * sizeof(glm::vec4),
-                        ray.trail.data(),
-                        GL_DYNAMIC_DRAW);
-            
-            GLint ModelLoc = glGetUniformLocation(shaderProgram, "model");
-            glUniformMatrix4fv(ModelLoc, 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f))); // Use identity matrix for trail
-             
-            GLint colorLocation = glGetUniformLocation(shaderProgram, "color");
-            glUniform3f(colorLocation, 1.0f, 1.0f, 1.0f);
-
-            glBindVertexArray(ray.trailVAO);
-            glDrawArrays(GL_LINE_STRIP, 0, ray.trail.size());
-            glBindVertexArray(0);
-        }
+glm::vec3 Ray::Interpolate(const double y0[4], const double y1[4], double dλ, double s) const{
+    double s2 = s * s, s3 = s2 * s;
+    double h00 = 2*s3 - 3*s2 + 1;
+    double h10 = s3 - 2*s2 + s;
+    double h01 = -2*s3 + 3*s2;
+    double h11 = s3 - s2;
+
+    double ri   = h00 * y0[0] + h10 * dλ * y0[2] + h01 * y1[0] + h11 * dλ * y1[2];
+    double phii = h00 * y0[1] + h10 * dλ * y0[3] + h01 * y1[1] + h11 * dλ * y1[3];
+
+    return glm::vec3(ri * (cos(phii) * basis_r + sin(phii) * basis_phi));
+}
+
+void Ray::Invariants(double r_s_meters, double& nullResidual, double& energyDrift, double& momentumDrift,
+                     const StepOptions& options) const{
+    nullResidual = energyDrift = momentumDrift = 0.0;
+    if (!invariantsSet || captured) return;
+    if (kerrSet) {
+        nullResidual = KerrNullResidual(kerr, kerrConstants);
+        return;
+    }
+    double y[4] = { r, phi, dr, dphi };
+    withMetric(options, ScreenSchwarzschildRadius(r_s_meters), [&](const auto& metric){
+        InvariantErrors(y, E, L, metric, nullResidual, energyDrift, momentumDrift);
+    });
+}
+
+void Ray::InvariantErrors(const double y[4], double E, double L, double rs,
+                          double& nullResidual, double& energyDrift, double& momentumDrift){
+    InvariantErrors(y, E, L, Schwarzschild(rs), nullResidual, energyDrift, momentumDrift);
+}
+
+template <class Metric>
+void Ray::InvariantErrors(const double y[4], double E, double L, const Metric& metric,
+                          double& nullResidual, double& energyDrift, double& momentumDrift){
+    double r = y[0], dr = y[2], dphi = y[3];
+    double f = metric.f(r);
+    // -f t'² + r'²/f + r² φ'² with t' = E/f
+    double H = (dr * dr - E * E) / f + r * r * dphi * dphi;
+    double Estate = sqrt(std::max(0.0, dr * dr + f * r * r * dphi * dphi));
+    nullResidual = std::abs(H) / (E * E);
+    energyDrift = std::abs(Estate - E) / E;
+    momentumDrift = L != 0.0 ? std::abs(r * r * dphi - L) / std::abs(L) : std::abs(r * r * dphi);
+}
 
-        // ---- Draw the Ray head ----
-        GLint ModelLoc = glGetUniformLocation(shaderProgram, "model");
-        glUniformMatrix4fv(ModelLoc, 1, GL_FALSE, glm::value_ptr(ray.model));
+void Ray::ProjectInvariants(double y[4], double E, double L, double rs){
+    ProjectInvariants(y, E, L, Schwarzschild(rs));
+}
+
+template <class Metric>
+void Ray::ProjectInvariants(double y[4], double E, double L, const Metric& metric){
+    double r = y[0];
+    y[3] = L / (r * r);
+    double target = E * E - metric.f(r) * L * L / (r * r);
+    if (target > 0.0) y[2] = std::copysign(sqrt(target), y[2]);
+}
 
-        GLint colorLocation = glGetUniformLocation(shaderProgram, "color");
-        glUniform3f(colorLocation, 1.0f, 1.0f, 1.0f); 
+void Ray::kerrRHS(const double y[5], const KerrConstants& k, double rhs[5]){
+    double r = y[0], theta = y[1];
+    double a = k.a, E = k.E, Lz = k.Lz;
+    double delta = r * r - 2.0 * k.M * r + a * a;
 
-        glBindVertexArray(ray.VAO);
-        glPointSize(1.0f);
-        glDrawArrays(GL_POINTS, 0, 1); 
-        glBindVertexArray(0);
+    // Same guard as geodesicRHS: freeze the ray at the horizon
+    if (delta <= 1e-10 * r * r) {
+        rhs[0] = rhs[1] = rhs[2] = rhs[3] = rhs[4] = 0.0;
+        return;
     }
 
-    glDisable(GL_BLEND);
+    double c = std::cos(theta), s = std::sin(theta);
+    double s2 = std::max(s * s, 1e-12);
+    double sigma = r * r + a * a * c * c;
+    double P = E * (r * r + a * a) - a * Lz;
+    double K = (Lz - a * E) * (Lz - a * E) + k.Q;
+
+    // R' = 4 E r P - 2 (r - M) K,  Θ' = 2 cosθ (Lz² / sin³θ - a² E² sinθ)
+    double dR = 4.0 * E * r * P - 2.0 * (r - k.M) * K;
+    double dTheta = 2.0 * c * (Lz * Lz / (s2 * s) - a * a * E * E * s);
+    double dPhi = Lz / s2 - a * E + a * P / delta;
+
+    rhs[0] = y[3] / sigma;
+    rhs[1] = y[4] / sigma;
+    rhs[2] = dPhi / sigma;
+    rhs[3] = 0.5 * dR / sigma;
+    rhs[4] = 0.5 * dTheta / sigma;
+}
+
+void Ray::rk4StepKerr(double y[5], const KerrConstants& k, double dλ){
+    double k1[5], k2[5], k3[5], k4[5], temp[5];
+
+    kerrRHS(y, k, k1);
+    for (int i = 0; i < 5; i++) temp[i] = y[i] + k1[i] * dλ / 2.0;
+    kerrRHS(temp, k, k2);
+
+    for (int i = 0; i < 5; i++) temp[i] = y[i] + k2[i] * dλ / 2.0;
+    kerrRHS(temp, k, k3);
 
+    for (int i = 0; i < 5; i++) temp[i] = y[i] + k3[i] * dλ;
+    kerrRHS(temp, k, k4);
+
+    for (int i = 0; i < 5; i++)
+        y[i] += (dλ/6.0)*(k1[i] + 2*k2[i] + 2*k3[i] + k4[i]);
+}
+
+void Ray::KerrInitialState(glm::vec3 pos, glm::vec3 dir, double a, double M, double y[5], KerrConstants& k){
+    // Invert the oblate spheroidal map: r⁴ - (ρ² - a²) r² - a² z² = 0
+    glm::dvec3 p(pos), v(dir);
+    double rho2 = glm::dot(p, p);
+    double b = rho2 - a * a;
+    double r = std::sqrt(0.5 * (b + std::sqrt(b * b + 4.0 * a * a * p.z * p.z)));
+    double theta = std::acos(std::clamp(r > 0.0 ? p.z / r : 0.0, -1.0, 1.0));
+    double phi = std::atan2(p.y, p.x);
+
+    glm::dvec3 rates = glm::inverse(kerrJacobian(r, theta, phi, a)) * v;
+    kerrConstantsOf(r, theta, rates, a, M, k);
+
+    double sigma = r * r + a * a * std::cos(theta) * std::cos(theta);
+    y[0] = r;
+    y[1] = theta;
+    y[2] = phi;
+    y[3] = sigma * rates.x;
+    y[4] = sigma * rates.y;
+}
+
+void Ray::deflectKerr(glm::dvec3 deltaV){
+    KerrConstants& k = kerrConstants;
+    double dy[5];
+    kerrRHS(kerr, k, dy);
+    glm::dvec3 rates(dy[0], dy[1], dy[2]);
+    glm::dmat3 jacobian = kerrJacobian(kerr[0], kerr[1], kerr[2], k.a);
+    glm::dvec3 kicked = rates + glm::inverse(jacobian) * deltaV;
+    kerrTurn += angleBetween(jacobian * rates, jacobian * kicked);
+
+    // The held constants move by the difference between those of the state
+    // before and after the kick
+    KerrConstants before, after;
+    kerrConstantsOf(kerr[0], kerr[1], rates, k.a, k.M, before);
+    kerrConstantsOf(kerr[0], kerr[1], kicked, k.a, k.M, after);
+    k.E += after.E - before.E;
+    k.Lz += after.Lz - before.Lz;
+    k.Q += after.Q - before.Q;
+    E = k.E;
+    L = k.Lz;
+
+    double c = std::cos(kerr[1]);
+    double sigma = kerr[0] * kerr[0] + k.a * k.a * c * c;
+    kerr[3] = sigma * kicked.x;
+    kerr[4] = sigma * kicked.y;
+
+    kerrRHS(kerr, k, dy);
+    KerrCartesian(kerr, dy, k.a, kerrEndPosition, kerrEndVelocity);
+    if (glm::length(kerrEndVelocity) > 0.0f) dir = glm::normalize(kerrEndVelocity) * speed;
 }
 
+void Ray::kerrConstantsOf(double r, double theta, glm::dvec3 rates, double a, double M, KerrConstants& k){
+    double dr = rates.x, dtheta = rates.y, dphi = rates.z;
+
+    // Boyer-Lindquist metric at (r, θ)
+    double st = std::sin(theta), ct = std::cos(theta);
+    double sigma = r * r + a * a * ct * ct;
+    double delta = r * r - 2.0 * M * r + a * a;
+    double gtt = -(1.0 - 2.0 * M * r / sigma);
+    double gtphi = -2.0 * M * a * r * st * st / sigma;
+    double gphiphi = (r * r + a * a + 2.0 * M * a * a * r * st * st / sigma) * st * st;
+    double spatial = sigma / delta * dr * dr + sigma * dtheta * dtheta + gphiphi * dphi * dphi;
+
+    // Future-directed root of gtt ṫ² + 2 gtφ φ̇ ṫ + spatial = 0 (gtt < 0
+    // outside the ergosphere, where the emitters are)
+    double B = 2.0 * gtphi * dphi;
+    double dt = (-B - std::sqrt(std::max(0.0, B * B - 4.0 * gtt * spatial))) / (2.0 * gtt);
+
+    k.a = a;
+    k.M = M;
+    k.E = -(gtt * dt + gtphi * dphi);
+    k.Lz = gtphi * dt + gphiphi * dphi;
+    double ptheta = sigma * dtheta;
+    k.Q = ptheta * ptheta + ct * ct * (k.Lz * k.Lz / std::max(st * st, 1e-12) - a * a * k.E * k.E);
+}
+
+void Ray::KerrCartesian(const double y[5], const double dy[5], double a, glm::vec3& pos, glm::vec3& vel){
+    double rho = std::sqrt(y[0] * y[0] + a * a);
+    double st = std::sin(y[1]);
+    pos = glm::vec3(static_cast<float>(rho * st * std::cos(y[2])),
+                    static_cast<float>(rho * st * std::sin(y[2])),
+                    static_cast<float>(y[0] * std::cos(y[1])));
+    vel = glm::vec3(kerrJacobian(y[0], y[1], y[2], a) * glm::dvec3(dy[0], dy[1], dy[2]));
+}
+
+double Ray::KerrHorizon(double a, double M){
+    return M + std::sqrt(std::max(0.0, M * M - a * a));
+}
+
+// R(r) and Θ(θ) of a Kerr null geodesic
+static void kerrPotentials(const double y[5], const KerrConstants& k, double& R, double& Theta){
+    double r = y[0], a = k.a, E = k.E, Lz = k.Lz;
+    double delta = r * r - 2.0 * k.M * r + a * a;
+    double P = E * (r * r + a * a) - a * Lz;
+    R = P * P - delta * ((Lz - a * E) * (Lz - a * E) + k.Q);
+    double c = std::cos(y[1]), s2 = std::max(std::sin(y[1]) * std::sin(y[1]), 1e-12);
+    Theta = k.Q + c * c * (a * a * E * E - Lz * Lz / s2);
+}
+
+double Ray::KerrNullResidual(const double y[5], const KerrConstants& k){
+    double R, Theta;
+    kerrPotentials(y, k, R, Theta);
+    double r = y[0], c = std::cos(y[1]);
+    double sigma = r * r + k.a * k.a * c * c;
+    double delta = r * r - 2.0 * k.M * r + k.a * k.a;
+    // g(v, v) = ((dr/dσ)² - R) / (Δ Σ) + ((dθ/dσ)² - Θ) / Σ
+    double H = ((y[3] * y[3] - R) / delta + (y[4] * y[4] - Theta)) / sigma;
+    return std::abs(H) / (k.E * k.E);
+}
+
+void Ray::ProjectKerr(double y[5], const KerrConstants& k){
+    double R, Theta;
+    kerrPotentials(y, k, R, Theta);
+    if (R > 0.0) y[3] = std::copysign(std::sqrt(R), y[3]);
+    if (Theta > 0.0) y[4] = std::copysign(std::sqrt(Theta), y[4]);
+}
+
+double Ray::ScreenSchwarzschildRadius(double r_s_meters){
+    double meters_per_unit = (r_s_meters * simulation_scale_factor) / 6;
+    return r_s_meters / meters_per_unit;
+}
 
 void Ray::geodesicRHS(const Ray& ray, double rhs[4], double rs){
-    double r    = ray.r;
-    double dr   = ray.dr;
-    double dphi = ray.dphi;
-    double E    = ray.E;
+    double y[4] = { ray.r, ray.phi, ray.dr, ray.dphi };
+    geodesicRHS(y, ray.E, rhs, rs);
+}
+
+void Ray::geodesicRHS(const double y[4], double E, double rhs[4], double rs){
+    geodesicRHS(y, E, rhs, Schwarzschild(rs));
+}
+
+template <class Metric>
+void Ray::geodesicRHS(const double y[4], double E, double rhs[4], const Metric& metric){
+    double r    = y[0];
+    double dr   = y[2];
+    double dphi = y[3];
 
     // Prevents calculatios too close to the event horizon
-    if (r <= rs * 1.01){
+    if (r <= metric.horizon * 1.01){
         rhs[0] = 0; // dr/dλ = 0
         rhs[1] = 0; // dφ/dλ = 0
         rhs[2] = 0; // d²r/dλ² = 0
@@ -194,7 +570,7 @@ void Ray::geodesicRHS(const Ray& ray, double rhs[4], double rs){
         return;
     }
 
-    double f = 1.0 - rs/r;
+    double f = metric.f(r);
 
     // Avoid numerical issues when f is very small
     if (f < 1e-10) {
@@ -210,41 +586,351 @@ void Ray::geodesicRHS(const Ray& ray, double rhs[4], double rs){
     // dφ/dλ = dphi
     rhs[1] = dphi;
 
-    // d²r/dλ² from Schwarzschild null geodesic:
+    // d²r/dλ² from the null geodesic of -f dt² + dr²/f + r² dΩ²
+    // (for Schwarzschild f' = rs/r² and f r = r - rs):
     double dt_dλ = E / f;
+    double df = metric.df(r);
     rhs[2] = 
-        - (rs/(2*r*r)) * f * (dt_dλ*dt_dλ)
-        + (rs/(2*r*r*f)) * (dr*dr)
-        + (r - rs) * (dphi*dphi);
+        - (df/2) * f * (dt_dλ*dt_dλ)
+        + (df/(2*f)) * (dr*dr)
+        + f * r * (dphi*dphi);
 
     // d²φ/dλ² = -2*(dr * dphi) / r
     rhs[3] = -2.0 * dr * dphi / r;
 }
 
+void Ray::deviationRHS(const double y[4], const double J[4], double E, double rhs[4], double rs){
+    double r    = y[0];
+    double dr   = y[2];
+    double dphi = y[3];
+    double f = 1.0 - rs/r;
+
+    // Same guards as geodesicRHS: the ray is frozen, so is its neighbourhood
+    if (r <= rs * 1.01 || f < 1e-10) {
+        rhs[0] = rhs[1] = rhs[2] = rhs[3] = 0;
+        return;
+    }
+
+    // geodesicRHS written as d²r/dλ² = rs (dr² - E²) / (2 r² f) + (r - rs) dphi²
+    double r2f = r*r - rs*r;
+    double dA_dr    = -rs * (dr*dr - E*E) * (2*r - rs) / (2 * r2f*r2f) + dphi*dphi;
+    double dA_ddr   = rs * dr / r2f;
+    double dA_ddphi = 2.0 * (r - rs) * dphi;
+
+    // d²φ/dλ² = -2 dr dphi / r
+    double dB_dr    = 2.0 * dr * dphi / (r*r);
+    double dB_ddr   = -2.0 * dphi / r;
+    double dB_ddphi = -2.0 * dr / r;
+
+    // φ does not appear on the right hand side, so J[1] never feeds back
+    rhs[0] = J[2];
+    rhs[1] = J[3];
+    rhs[2] = dA_dr * J[0] + dA_ddr * J[2] + dA_ddphi * J[3];
+    rhs[3] = dB_dr * J[0] + dB_ddr * J[2] + dB_ddphi * J[3];
+}
+
 void Ray::addState(const double a[4], const double b[4], double factor, double out[4]) {
     for (int i = 0; i < 4; i++)
         out[i] = a[i] + b[i] * factor;
 }
 
 void Ray::rk4Step(Ray& ray, double dλ, double rs) {
-    double y0[4] = { ray.r, ray.phi, ray.dr, ray.dphi };
+    double y[4] = { ray.r, ray.phi, ray.dr, ray.dphi };
+    rk4Step(y, ray.E, dλ, rs);
+    ray.r = y[0]; ray.phi = y[1]; ray.dr = y[2]; ray.dphi = y[3];
+}
+
+void Ray::rk4Step(double y[4], double E, double dλ, double rs) {
+    rk4Step(y, E, dλ, Schwarzschild(rs));
+}
+
+template <class Metric>
+void Ray::rk4Step(double y[4], double E, double dλ, const Metric& metric) {
+    double k1[4], k2[4], k3[4], k4[4], temp[4];
+
+    geodesicRHS(y, E, k1, metric);
+    addState(y, k1, dλ/2.0, temp);
+    geodesicRHS(temp, E, k2, metric);
+
+    addState(y, k2, dλ/2.0, temp);
+    geodesicRHS(temp, E, k3, metric);
+
+    addState(y, k3, dλ, temp);
+    geodesicRHS(temp, E, k4, metric);
+
+    for (int i = 0; i < 4; i++)
+        y[i] += (dλ/6.0)*(k1[i] + 2*k2[i] + 2*k3[i] + k4[i]);
+}
+
+// Exact flows of the two halves of the split vector field:
+//   drift: r' = dr                             (dr, phi frozen)
+//   kick:  dr' = L² (f/r³ - f'/(2r²)),  phi' = L/r²   (r frozen)
+// phi rides along with the kick since it only depends on r. For Schwarzschild
+// the kick is L²/r³ - 1.5 rs L²/r⁴.
+static void drift(double y[4], double dλ){
+    y[0] += dλ * y[2];
+}
+
+template <class Metric>
+static void kick(double y[4], double L, double dλ, const Metric& metric){
+    double r = y[0];
+    double u = 1.0 / r;
+    double L2u3 = L * L * u * u * u;
+    y[2] += dλ * L2u3 * (metric.f(r) - 0.5 * r * metric.df(r));
+    y[1] += dλ * L * u * u;
+}
+
+void Ray::leapfrogStep(double y[4], double dλ, double rs){
+    leapfrogStep(y, dλ, Schwarzschild(rs));
+}
+
+template <class Metric>
+void Ray::leapfrogStep(double y[4], double dλ, const Metric& metric){
+    double L = y[0] * y[0] * y[3];
+    drift(y, 0.5 * dλ);
+    kick(y, L, dλ, metric);
+    drift(y, 0.5 * dλ);
+    y[3] = L / (y[0] * y[0]);
+}
+
+void Ray::yoshida4Step(double y[4], double dλ, double rs){
+    yoshida4Step(y, dλ, Schwarzschild(rs));
+}
+
+template <class Metric>
+void Ray::yoshida4Step(double y[4], double dλ, const Metric& metric){
+    // Triple jump: w1, w0, w1 with 2 w1 + w0 = 1 cancels the third-order error
+    const double cbrt2 = std::cbrt(2.0);
+    const double w1 = 1.0 / (2.0 - cbrt2);
+    const double w0 = -cbrt2 / (2.0 - cbrt2);
+
+    // Drift-kick-drift substeps with the adjacent half drifts merged
+    double L = y[0] * y[0] * y[3];
+    drift(y, 0.5 * w1 * dλ);
+    kick(y, L, w1 * dλ, metric);
+    drift(y, 0.5 * (w1 + w0) * dλ);
+    kick(y, L, w0 * dλ, metric);
+    drift(y, 0.5 * (w0 + w1) * dλ);
+    kick(y, L, w1 * dλ, metric);
+    drift(y, 0.5 * w1 * dλ);
+    y[3] = L / (y[0] * y[0]);
+}
+
+void Ray::regularRHS(const double y[4], double rhs[4], double rs){
+    regularRHS(y, rhs, Schwarzschild(rs));
+}
+
+template <class Metric>
+void Ray::regularRHS(const double y[4], double rhs[4], const Metric& metric){
+    double r    = y[0];
+    double dr   = y[2];
+    double dphi = y[3];
+
+    // (f r - f' r²/2) dphi², which is (r - 1.5 rs) dphi² for Schwarzschild
+    rhs[0] = dr;
+    rhs[1] = dphi;
+    rhs[2] = (metric.f(r) * r - 0.5 * metric.df(r) * r * r) * dphi * dphi;
+    rhs[3] = -2.0 * dr * dphi / r;
+}
+
+void Ray::rk4StepRegular(double y[4], double dλ, double rs) {
+    rk4StepRegular(y, dλ, Schwarzschild(rs));
+}
+
+template <class Metric>
+void Ray::rk4StepRegular(double y[4], double dλ, const Metric& metric) {
     double k1[4], k2[4], k3[4], k4[4], temp[4];
 
-    geodesicRHS(ray, k1, rs);
-    addState(y0, k1, dλ/2.0, temp);
-    Ray r2 = ray; r2.r=temp[0]; r2.phi=temp[1]; r2.dr=temp[2]; r2.dphi=temp[3];
-    geodesicRHS(r2, k2, rs);
+    regularRHS(y, k1, metric);
+    addState(y, k1, dλ/2.0, temp);
+    regularRHS(temp, k2, metric);
+
+    addState(y, k2, dλ/2.0, temp);
+    regularRHS(temp, k3, metric);
+
+    addState(y, k3, dλ, temp);
+    regularRHS(temp, k4, metric);
+
+    for (int i = 0; i < 4; i++)
+        y[i] += (dλ/6.0)*(k1[i] + 2*k2[i] + 2*k3[i] + k4[i]);
+}
+
+void Ray::farZoneStep(double y[4], double dλ, double rs){
+    // Planar frame with x along the current radius: position p, velocity v
+    double px = y[0], py = 0.0;
+    double vx = y[2], vy = y[0] * y[3];
+    double w = std::sqrt(vx * vx + vy * vy);
+    if (w <= 0.0) return;
+    double tx = vx / w, ty = vy / w;
+
+    // Straight line x(s) = b n + s t, s measured from closest approach
+    double sa = px * tx + py * ty;
+    double sb = sa + w * dλ;
+    double nx = px - sa * tx, ny = py - sa * ty;
+    double b = std::sqrt(nx * nx + ny * ny);
+
+    double dx = vx * dλ, dy = vy * dλ;
+    // Radial rays (L = 0) feel no force and run straight
+    if (b > 1e-9 * y[0]) {
+        nx /= b; ny /= b;
+        double ra = std::sqrt(b * b + sa * sa), rb = std::sqrt(b * b + sb * sb);
+        double ca = sa / ra, cb = sb / rb;
+
+        // With k = 1.5 rs L² = 1.5 rs b² w², the kick and displacement need
+        //   ∫ s/ρ⁵ = -1/(3ρ³), k ∫ 1/ρ⁵ = rs w² (3c - c³)/(2b), k ∫ s²/ρ⁵ = rs w² c³/2
+        // with c = s/ρ. (3c - c³)/b is taken in a form without cancellation:
+        // on one side of closest approach c_a ≈ c_b for lines that nearly
+        // pass through the hole.
+        double d3c;
+        if (sa * sb > 0.0) {
+            double dc = b * (sb - sa) * (sa + sb) / ((sb * ra + sa * rb) * ra * rb);
+            double cross = b * (sa * sa + sb * sb + b * b) / ((ra * rb + sa * sb) * ra * rb);
+            double bracket = b / (ra * ra) + b / (rb * rb) + cross;
+            d3c = dc * bracket * b;
+        } else {
+            d3c = (3.0 * (cb - ca) - (cb * cb * cb - ca * ca * ca)) / b;
+        }
+        double dP = -1.0 / (3.0 * rb * rb * rb) + 1.0 / (3.0 * ra * ra * ra);
+        double kQ = 0.5 * rs * w * w * d3c;                      // k b ΔQ
+        double kP = 1.5 * rs * b * b * w * w * dP;               // k ΔP
+        double kS = 0.5 * rs * w * w * (cb * cb * cb - ca * ca * ca);  // k ΔS
+
+        // Δv = -(k/w)(b ΔQ n + ΔP t), Δx = -(k/w²)(b (s_b ΔQ - ΔP) n + (s_b ΔP - ΔS) t)
+        double kickN = -kQ / w, kickT = -kP / w;
+        double shiftN = -(sb * kQ - b * kP) / (w * w);
+        double shiftT = -(sb * kP - kS) / (w * w);
+        vx += kickN * nx + kickT * tx;
+        vy += kickN * ny + kickT * ty;
+        dx += shiftN * nx + shiftT * tx;
+        dy += shiftN * ny + shiftT * ty;
+    }
+
+    // Back to polar about the new position
+    px += dx; py += dy;
+    double r = std::sqrt(px * px + py * py);
+    double ex = px / r, ey = py / r;
+    y[0] = r;
+    y[1] += std::atan2(py, px);
+    y[2] = vx * ex + vy * ey;
+    y[3] = (vy * ex - vx * ey) / r;
+}
+
+double Ray::FarZoneReach(const double y[4], double R){
+    double w = std::sqrt(y[2] * y[2] + y[0] * y[0] * y[3] * y[3]);
+    if (y[2] >= 0.0 || w <= 0.0) return std::numeric_limits<double>::infinity();
+    // Distance to closest approach along the line, and the line's impact parameter
+    double s = -y[0] * y[2] / w;
+    double b = y[0] * y[0] * std::abs(y[3]) / w;
+    if (b >= R) return std::numeric_limits<double>::infinity();
+    return std::max(0.0, (s - std::sqrt(R * R - b * b)) / w);
+}
 
-    addState(y0, k2, dλ/2.0, temp);
-    Ray r3 = ray; r3.r=temp[0]; r3.phi=temp[1]; r3.dr=temp[2]; r3.dphi=temp[3];
-    geodesicRHS(r3, k3, rs);
+void Ray::Advance(const StepOptions& options, double y[4], double E, double L, double dλ, double rs){
+    withMetric(options, rs, [&](const auto& metric){ Advance(options, y, E, L, dλ, metric); });
+}
 
-    addState(y0, k3, dλ, temp);
-    Ray r4 = ray; r4.r=temp[0]; r4.phi=temp[1]; r4.dr=temp[2]; r4.dphi=temp[3];
-    geodesicRHS(r4, k4, rs);
+template <class Metric>
+void Ray::Advance(const StepOptions& options, double y[4], double E, double L, double dλ, const Metric& metric){
+    // The far zone expansion is about the Schwarzschild field alone
+    if constexpr (std::is_same_v<Metric, Schwarzschild>) {
+        if (options.farRadius > 0.0 && y[0] > options.farRadius * metric.rs) {
+            farZoneStep(y, dλ, metric.rs);
+            if (options.projectInvariants) ProjectInvariants(y, E, L, metric);
+            return;
+        }
+    }
+    switch (options.integrator) {
+    case Integrator::RK4:
+        // The symplectic schemes already work on the regular radial equation
+        if (options.regularizeHorizon && y[0] < options.regularRadius * metric.rs) rk4StepRegular(y, dλ, metric);
+        else rk4Step(y, E, dλ, metric);
+        break;
+    case Integrator::Leapfrog:
+        leapfrogStep(y, dλ, metric);
+        break;
+    case Integrator::Yoshida4:
+        yoshida4Step(y, dλ, metric);
+        break;
+    }
+    if (options.projectInvariants) ProjectInvariants(y, E, L, metric);
+}
+
+// The precompiled spacetimes; other translation units only see the declarations
+#define INSTANTIATE_METRIC(Metric) \
+    template void Ray::geodesicRHS<Metric>(const double[4], double, double[4], const Metric&); \
+    template void Ray::rk4Step<Metric>(double[4], double, double, const Metric&); \
+    template void Ray::regularRHS<Metric>(const double[4], double[4], const Metric&); \
+    template void Ray::rk4StepRegular<Metric>(double[4], double, const Metric&); \
+    template void Ray::leapfrogStep<Metric>(double[4], double, const Metric&); \
+    template void Ray::yoshida4Step<Metric>(double[4], double, const Metric&); \
+    template void Ray::Advance<Metric>(const StepOptions&, double[4], double, double, double, const Metric&); \
+    template void Ray::InvariantErrors<Metric>(const double[4], double, double, const Metric&, double&, double&, double&); \
+    template void Ray::ProjectInvariants<Metric>(double[4], double, double, const Metric&);
+
+INSTANTIATE_METRIC(Schwarzschild)
+INSTANTIATE_METRIC(ReissnerNordstrom)
+INSTANTIATE_METRIC(SchwarzschildDeSitter)
+#undef INSTANTIATE_METRIC
+
+int Ray::RHSEvaluations(Integrator integrator){
+    switch (integrator) {
+    case Integrator::RK4: return 4;
+    case Integrator::Leapfrog: return 1;
+    case Integrator::Yoshida4: return 3;
+    }
+    return 0;
+}
 
-    ray.r    += (dλ/6.0)*(k1[0] + 2*k2[0] + 2*k3[0] + k4[0]);
-    ray.phi  += (dλ/6.0)*(k1[1] + 2*k2[1] + 2*k3[1] + k4[1]);
-    ray.dr   += (dλ/6.0)*(k1[2] + 2*k2[2] + 2*k3[2] + k4[2]);
-    ray.dphi += (dλ/6.0)*(k1[3] + 2*k2[3] + 2*k3[3] + k4[3]);
+const char* Ray::IntegratorName(Integrator integrator){
+    switch (integrator) {
+    case Integrator::RK4: return "rk4";
+    case Integrator::Leapfrog: return "leapfrog";
+    case Integrator::Yoshida4: return "yoshida4";
+    }
+    return "unknown";
+}
+
+bool Ray::ParseIntegrator(const std::string& name, Integrator& integrator){
+    for (Integrator candidate : Integrators()) {
+        if (name == IntegratorName(candidate)) {
+            integrator = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+const std::vector<Integrator>& Ray::Integrators(){
+    static const std::vector<Integrator> all = { Integrator::RK4, Integrator::Leapfrog, Integrator::Yoshida4 };
+    return all;
+}
+
+void Ray::rk4StepDeviation(double y[4], double J[2][4], double E, double dλ, double rs) {
+    // Augmented system (y, J0, J1): the fields are evaluated on the same
+    // intermediate states as the geodesic
+    double k1[3][4], k2[3][4], k3[3][4], k4[3][4], temp[3][4];
+
+    geodesicRHS(y, E, k1[0], rs);
+    for (int n = 0; n < 2; n++) deviationRHS(y, J[n], E, k1[n + 1], rs);
+
+    addState(y, k1[0], dλ/2.0, temp[0]);
+    for (int n = 0; n < 2; n++) addState(J[n], k1[n + 1], dλ/2.0, temp[n + 1]);
+    geodesicRHS(temp[0], E, k2[0], rs);
+    for (int n = 0; n < 2; n++) deviationRHS(temp[0], temp[n + 1], E, k2[n + 1], rs);
+
+    addState(y, k2[0], dλ/2.0, temp[0]);
+    for (int n = 0; n < 2; n++) addState(J[n], k2[n + 1], dλ/2.0, temp[n + 1]);
+    geodesicRHS(temp[0], E, k3[0], rs);
+    for (int n = 0; n < 2; n++) deviationRHS(temp[0], temp[n + 1], E, k3[n + 1], rs);
+
+    addState(y, k3[0], dλ, temp[0]);
+    for (int n = 0; n < 2; n++) addState(J[n], k3[n + 1], dλ, temp[n + 1]);
+    geodesicRHS(temp[0], E, k4[0], rs);
+    for (int n = 0; n < 2; n++) deviationRHS(temp[0], temp[n + 1], E, k4[n + 1], rs);
+
+    for (int i = 0; i < 4; i++) {
+        y[i] += (dλ/6.0)*(k1[0][i] + 2*k2[0][i] + 2*k3[0][i] + k4[0][i]);
+        for (int n = 0; n < 2; n++)
+            J[n][i] += (dλ/6.0)*(k1[n + 1][i] + 2*k2[n + 1][i] + 2*k3[n + 1][i] + k4[n + 1][i]);
+    }
 }
@@ -1,5 +1,36 @@
 #pragma once 
-#include "config.h"
+#include "core_config.h"
+#include "Metric.h"
+
+// Scheme used by Ray::Step to advance the geodesic
+enum class Integrator {
+    RK4,        // classic fourth-order Runge-Kutta on (r, phi, dr, dphi)
+    Leapfrog,   // second-order symplectic (drift-kick-drift) on the radial Hamiltonian
+    Yoshida4,   // fourth-order Yoshida composition of three leapfrog steps
+};
+
+// How Ray::Step advances a ray
+struct StepOptions{
+    Integrator integrator = Integrator::RK4;
+    bool projectInvariants = false;     // pull (dr, dphi) back onto the E, L constraint (Ray::ProjectInvariants)
+    bool regularizeHorizon = false;     // horizon-regular right hand side near r_s (Ray::regularRHS)
+    double regularRadius = 3.0;         // where the regular form takes over, in units of r_s
+    double trailSpacing = 0.0;          // affine parameter between trail points, 0 = one per step
+    double farRadius = 0.0;             // weak-field analytic steps beyond this, in units of r_s; 0 = off (Ray::farZoneStep)
+    double farStepScale = 0.5;          // step cap relative to r for callers sizing their own steps in the far zone
+    Spacetime spacetime = Spacetime::Schwarzschild;   // metric policy the steps are compiled for (Metric.h)
+    double charge = 0.0;                // Reissner-Nordström rq in units of r_s, horizons up to 0.5
+    double cosmologicalConstant = 0.0;  // Schwarzschild-de Sitter Λ in units of 1/r_s², horizons below 4/27
+    double spin = 0.0;                  // Kerr a/M; nonzero switches to Ray::kerrRHS (Simulation takes it from BlackHole::spin)
+};
+
+// Constants of a Kerr null geodesic in Boyer-Lindquist coordinates: spin a
+// and mass M (lengths, M = rs/2), energy E, axial angular momentum Lz and
+// Carter's constant Q
+struct KerrConstants{
+    double a, M;
+    double E, Lz, Q;
+};
 
 struct Ray{
     // Cartesian position
@@ -12,6 +43,9 @@ struct Ray{
 
     // Conserve quantities 
     double E, L;
+    // E and L are taken from the state on the first Step, once r_s is known:
+    // L = r² dphi and E from the null condition dr² + f L²/r² = E²
+    bool invariantsSet = false;
     
      
     static constexpr double simulation_scale_factor = 10.0; 
@@ -20,30 +54,225 @@ struct Ray{
 
     // Trail of points (x,y,z,alpha)
     std::vector<glm::vec4> trail;
-    size_t maxTrailLength = 1000;
-
-    glm::mat4 model = glm::mat4(1.0f);
+    size_t maxTrailLength = 1000;     // 0 keeps no trail at all
 
     glm::vec3 dir;
+    // Angle of dir from the radius at emission, in the motion plane, and
+    // for Kerr rays the turn of dir summed over the steps (see Deflection)
+    double initialHeading = 0.0;
+    double kerrTurn = 0.0;
 
-    // Plane basis vectors for this ray's motion (motion is planar due to spherical symmetry)
-    glm::vec3 basis_r;   // radial unit vector at initialization
-    glm::vec3 basis_phi; // tangential unit vector in plane
-    glm::vec3 plane_normal;
+    // Importance weight from the emitter: how many rays of an unbiased beam
+    // this one stands for. Tallies of density or flux sum it; 1 when the
+    // emitter samples the beam uniformly.
+    float weight = 1.0f;
 
-    GLuint VAO, VBO;
-    GLuint trailVAO, trailVBO; 
+    // Set once the ray has reached the horizon; Step leaves it in place
+    bool captured = false;
+
+    // Affine parameter owed but not yet integrated (screen-space stepping)
+    double pendingLambda = 0.0;
+
+    // Affine parameter integrated so far, and where the next trail point goes
+    // when StepOptions::trailSpacing is set
+    double lambda = 0.0;
+    double nextTrailLambda = 0.0;
+
+    // The last step (state at its start and its length), kept for dense
+    // output between steps
+    double stepStart[4] = { 0.0, 0.0, 0.0, 0.0 };
+    double stepLength = 0.0;
+
+    // Kerr rays (StepOptions::spin != 0) leave the planar basis behind: the
+    // state is Boyer-Lindquist y = (r, θ, φ, dr/dσ, dθ/dσ) about the world z
+    // axis, σ being Mino time (dλ = Σ dσ), set up from position and dir on
+    // the first step. r, phi and dr above mirror it; dphi holds the total
+    // angular rate, so r dphi stays the transverse speed.
+    bool kerrSet = false;
+    double kerr[5] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+    KerrConstants kerrConstants = {};
+    // Cartesian position and velocity at both ends of the last Kerr step,
+    // for cubic Hermite dense output
+    glm::vec3 kerrStartPosition, kerrStartVelocity, kerrEndPosition, kerrEndVelocity;
+
+    // Plane basis vectors for this ray's motion (motion is planar due to spherical symmetry).
+    // Double precision, as Deflect turns them by tiny angles every step.
+    glm::dvec3 basis_r;   // radial unit vector at phi = 0
+    glm::dvec3 basis_phi; // tangential unit vector in plane
+    glm::dvec3 plane_normal;
 
     // Constructor
     Ray(glm::vec3 pos, glm::vec3 dir);
 
-    void SetupMesh();
-    void Step(double dLambda, double r_s);
+    // Advances the ray by dLambda. Returns false, without integrating, once
+    // the ray has been captured: at 1.05 r_s, or at r_s itself when the
+    // horizon-regular form is in use.
+    bool Step(double dLambda, double r_s, const StepOptions& options = StepOptions());
+
+    // The integration half of Step: advances state, clock, position and
+    // direction but leaves the trail alone
+    bool Integrate(double dLambda, double r_s, const StepOptions& options = StepOptions());
+    // Push trail points at every multiple of spacing up to min(upTo, lambda),
+    // sampled from the last step
+    void EmitTrail(double upTo, double spacing);
+    // Move the head to affine time t inside the last step (dense output)
+    void SampleAt(double t);
+
+    // Change the velocity by deltaV (an impulse from outside the black hole's
+    // own field, e.g. LensTree). The motion plane turns about the current
+    // radius to contain the new velocity, keeping r and phi, and E, L (Lz, Q
+    // for Kerr) move by the kick's exact change of the state's own constants,
+    // so the integration error they carry, and InvariantErrors reports, is
+    // untouched. Kicks below 1e-12 of the speed are skipped.
+    void Deflect(glm::dvec3 deltaV, double r_s, const StepOptions& options = StepOptions());
+    // Position and velocity dx/dλ at the end of the last step, in double
+    // precision (position may hold a dense-output sample before that)
+    glm::dvec3 StatePosition() const;
+    glm::dvec3 Velocity() const;
+    // Angle the direction has turned through since emission, unwrapped, so
+    // a ray that winds around the hole reports more than π. For Schwarzschild
+    // rays it is the swept phi plus the change of the heading against the
+    // radius (Δφ - π for a ray from and to infinity); Kerr rays add up the
+    // turn of each step.
+    double Deflection() const;
+
+    // Dense output: position at fraction s in [0, 1] of the step from state y0
+    // to y1 of length dλ. Cubic Hermite in r and phi; their derivatives are
+    // the state's own dr and dphi, so it costs no right hand side evaluations
+    // and is fourth-order accurate like the RK4 step itself.
+    glm::vec3 Interpolate(const double y0[4], const double y1[4], double dλ, double s) const;
+
+    // Relative invariant errors of this ray in the spacetime of options, see InvariantErrors
+    void Invariants(double r_s, double& nullResidual, double& energyDrift, double& momentumDrift,
+                    const StepOptions& options = StepOptions()) const;
     //void calculateSchwarzschildGeodesic(double r_s_meter, double dt);
     void geodesicRHS(const Ray& ray, double rhs[4], double rs);
-    void addState(const double a[4], const double b[4], double factor, double out[4]); 
+    static void addState(const double a[4], const double b[4], double factor, double out[4]); 
     void rk4Step(Ray& ray, double dλ, double rs); 
 
-    static void Draw(const std::vector<Ray>& rays, GLuint shaderProgram);
+    // State-only versions of the integrator, y = (r, phi, dr, dphi),
+    // shared with the per-pixel lensing tracer.
+    static void geodesicRHS(const double y[4], double E, double rhs[4], double rs);
+    static void rk4Step(double y[4], double E, double dλ, double rs);
+
+    // Symplectic steps on the separable Hamiltonian K = dr²/2 + f L²/(2r²)
+    // (K = E²/2 on the null cone), with L = r² dphi taken from y and held
+    // exactly. The energy error stays bounded instead of drifting, which is
+    // what keeps photons near the photon sphere from spiralling out.
+    static void leapfrogStep(double y[4], double dλ, double rs);
+    static void yoshida4Step(double y[4], double dλ, double rs);
+
+    // Horizon-regular form of geodesicRHS. On the null cone the E²/f and
+    // dr²/f terms combine to -f L²/r² (times rs/2r²), leaving
+    //   d²r/dλ² = (r - 1.5 rs) dphi²
+    // which has no 1/f and no guards: λ and r are regular across the horizon,
+    // only t blows up there, and t is never integrated. Same trajectories as
+    // geodesicRHS as long as the state is on the null cone.
+    static void regularRHS(const double y[4], double rhs[4], double rs);
+    static void rk4StepRegular(double y[4], double dλ, double rs);
+
+    // Weak-field step for r far outside rs. On the null cone the in-plane
+    // acceleration is the central -1.5 rs L² x / r⁵ (see regularRHS), which
+    // to first order in rs/r can be integrated along the unperturbed straight
+    // line in closed form: the velocity kick and displacement are elementary
+    // integrals of 1/ρ⁵ with ρ² = b² + s². Over a whole pass this gives the
+    // 2 rs / b deflection. Steps of any length cost a handful of square roots;
+    // errors are second order in rs/r.
+    static void farZoneStep(double y[4], double dλ, double rs);
+    // Affine parameter an inbound ray at y can cover before its straight line
+    // reaches radius R, so jumps stop where the strong field begins. Infinite
+    // for outbound rays and lines that miss R.
+    static double FarZoneReach(const double y[4], double R);
+
+    // One step on the state y as Ray::Step takes it: the chosen integrator,
+    // the regular form inside options.regularRadius, then the projection, with
+    // farZoneStep replacing the integrator beyond options.farRadius. The rs
+    // form picks the metric policy for options.spacetime once per step.
+    static void Advance(const StepOptions& options, double y[4], double E, double L, double dλ, double rs);
+
+    // The integrators above for any metric policy from Metric.h; the rs
+    // overloads are the Schwarzschild instances. With ṫ = E/f,
+    //   d²r/dλ² = f' (dr² - E²) / (2f) + f r dphi²
+    // and, on the null cone, the regular form d²r/dλ² = (f r - f' r²/2) dphi²
+    // and the symplectic kick dr' = L² (f/r³ - f'/(2r²)). Instantiated in
+    // Ray.cpp for Schwarzschild, ReissnerNordstrom and SchwarzschildDeSitter.
+    template <class Metric> static void geodesicRHS(const double y[4], double E, double rhs[4], const Metric& metric);
+    template <class Metric> static void rk4Step(double y[4], double E, double dλ, const Metric& metric);
+    template <class Metric> static void regularRHS(const double y[4], double rhs[4], const Metric& metric);
+    template <class Metric> static void rk4StepRegular(double y[4], double dλ, const Metric& metric);
+    template <class Metric> static void leapfrogStep(double y[4], double dλ, const Metric& metric);
+    template <class Metric> static void yoshida4Step(double y[4], double dλ, const Metric& metric);
+    template <class Metric>
+    static void Advance(const StepOptions& options, double y[4], double E, double L, double dλ, const Metric& metric);
+    // Right hand side evaluations per step, the cost measure used by the benchmarks
+    static int RHSEvaluations(Integrator integrator);
+    // Command line names ("rk4", ...). Parse returns false for unknown names.
+    static const char* IntegratorName(Integrator integrator);
+    static bool ParseIntegrator(const std::string& name, Integrator& integrator);
+    static const std::vector<Integrator>& Integrators();
+
+    // Invariants of the state y for a ray with constants E and L:
+    //   nullResidual  |g(v, v)| / E², zero on the null cone
+    //   energyDrift   |E(y) - E| / E, E(y) from the null condition
+    //   momentumDrift |r² dphi - L| / |L|
+    static void InvariantErrors(const double y[4], double E, double L, double rs,
+                                double& nullResidual, double& energyDrift, double& momentumDrift);
+    template <class Metric>
+    static void InvariantErrors(const double y[4], double E, double L, const Metric& metric,
+                                double& nullResidual, double& energyDrift, double& momentumDrift);
+    // Cheap projection back onto the constraint surface: dphi = L / r², and dr
+    // rescaled so that dr² + f L²/r² = E² (left alone at turning points, where
+    // the target is negative). Costs no right hand side evaluations.
+    static void ProjectInvariants(double y[4], double E, double L, double rs);
+    template <class Metric> static void ProjectInvariants(double y[4], double E, double L, const Metric& metric);
+
+    // Geodesic deviation (Jacobi) fields: J is the linearization of the state
+    // around y, i.e. how a neighbouring ray in the same plane differs from this
+    // one. deviationRHS gives dJ/dλ; rk4StepDeviation advances y together with
+    // two fields J[0], J[1] using the same RK4 stages.
+    static void deviationRHS(const double y[4], const double J[4], double E, double rhs[4], double rs);
+    static void rk4StepDeviation(double y[4], double J[2][4], double E, double dλ, double rs);
+
+    // Kerr null geodesics in the first-order Carter form. In Mino time
+    //   (dr/dσ)² = R(r) = P² - Δ ((Lz - aE)² + Q),  P = E (r² + a²) - a Lz
+    //   (dθ/dσ)² = Θ(θ) = Q + cos²θ (a² E² - Lz² / sin²θ)
+    //   dφ/dσ = Lz / sin²θ - a E + a P / Δ
+    // with Δ = r² - 2Mr + a². The square roots flip sign at turning points, so
+    // r and θ are advanced with d²r/dσ² = R'/2 and d²θ/dσ² = Θ'/2 instead;
+    // no Christoffel symbols are needed. kerrRHS gives d/dλ = (1/Σ) d/dσ of
+    // y = (r, θ, φ, dr/dσ, dθ/dσ), Σ = r² + a² cos²θ; rk4StepKerr is RK4 on it.
+    static void kerrRHS(const double y[5], const KerrConstants& k, double rhs[5]);
+    static void rk4StepKerr(double y[5], const KerrConstants& k, double dλ);
+    // Constants and state for a photon at Cartesian pos moving along dir
+    // (coordinate velocity), with dt/dλ from the null condition, as for the
+    // Schwarzschild rays. pos is taken as Kerr-Schild-like Cartesian:
+    // x + iy = sqrt(r² + a²) sinθ e^{iφ}, z = r cosθ.
+    static void KerrInitialState(glm::vec3 pos, glm::vec3 dir, double a, double M, double y[5], KerrConstants& k);
+    // Cartesian position, and velocity for the state derivative dy = kerrRHS(y)
+    static void KerrCartesian(const double y[5], const double dy[5], double a, glm::vec3& pos, glm::vec3& vel);
+    // Outer horizon r+ = M + sqrt(M² - a²)
+    static double KerrHorizon(double a, double M);
+    // |g(v, v)| / E² of a Kerr state, from how far dr/dσ and dθ/dσ are off
+    // their potentials R and Θ; E, Lz and Q are held exactly
+    static double KerrNullResidual(const double y[5], const KerrConstants& k);
+    // Rescale dr/dσ and dθ/dσ back onto sqrt(R) and sqrt(Θ) (left alone at
+    // turning points, where the potential is negative)
+    static void ProjectKerr(double y[5], const KerrConstants& k);
+
+    // Schwarzschild radius in screen units for a black hole of r_s_meters
+    static double ScreenSchwarzschildRadius(double r_s_meters);
+
+private:
+    // Kerr half of Integrate, taken when options.spin is nonzero
+    bool integrateKerr(double dLambda, double r_s_screen, const StepOptions& options);
+    // Kerr half of Deflect
+    void deflectKerr(glm::dvec3 deltaV);
+    // E, Lz and Q of a photon at (r, θ) with Boyer-Lindquist rates (dr, dθ, dφ)/dλ,
+    // dt/dλ from the null condition
+    static void kerrConstantsOf(double r, double theta, glm::dvec3 rates, double a, double M, KerrConstants& k);
+    // Head position at fraction s of the last step, Schwarzschild or Kerr
+    glm::vec3 samplePosition(double s) const;
+    // Drop the oldest points beyond maxTrailLength and refresh the alpha ramp
+    void trimTrail();
 };
 
@@ -0,0 +1,26 @@
+#pragma once
+#include "BlackHole.h"
+#include "DensityGrid.h"
+#include "ParticleSwarm.h"
+#include "Ray.h"
+
+// Draws the simulation. The core (rays, black hole, stepping) never calls GL;
+// everything GPU-side sits behind this interface.
+class Renderer {
+public:
+    virtual ~Renderer() = default;
+    virtual void DrawBlackHole(const BlackHole& blackhole) = 0;
+    virtual void DrawRays(const std::vector<Ray>& rays) = 0;
+    virtual void DrawParticles(const ParticleSwarm& particles) = 0;
+    virtual void DrawDensity(const DensityGrid& density) = 0;
+};
+
+// Draws nothing. Lets the simulation run at full CPU speed with no GL
+// context, display or driver, e.g. for benchmarks and batch runs.
+class NullRenderer : public Renderer {
+public:
+    void DrawBlackHole(const BlackHole&) override {}
+    void DrawRays(const std::vector<Ray>&) override {}
+    void DrawParticles(const ParticleSwarm&) override {}
+    void DrawDensity(const DensityGrid&) override {}
+};
@@ -0,0 +1,322 @@
+#include "Simulation.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+void Simulation::InitializeRays(int numRays){
+    clock = 0.0;
+    size_t count = static_cast<size_t>(std::max(0, numRays));
+    rays.assign(count, Ray(glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f)));
+
+    // Ray i depends only on (seed, i), so the blocks can be filled in any
+    // order by any number of workers
+    const double rs = Ray::ScreenSchwarzschildRadius(blackhole.r_s);
+    auto emit = [&](size_t i){
+        auto u = [&](uint32_t dimension){ return float(Sample(sampling, seed, i, dimension)); };
+        if (impact.enabled) {
+            double weight;
+            double b = impact.Sample(Sample(sampling, seed, i, 0), Sample(sampling, seed, i, 1), weight) * rs;
+            double psi = 2.0 * glm::pi<double>() * Sample(sampling, seed, i, 2);
+            double x = impact.startX - 0.6 * Sample(sampling, seed, i, 3);
+
+            // The ray starts in the field, where E = sqrt(dr² + f r² dφ²)
+            // makes L/E exceed the offset d from the axis:
+            //   b² (1 - rs d² / r³) = d²,  r² = x² + d²
+            // so the offset is solved for to hit b exactly
+            double d = b;
+            for (int k = 0; k < 8; ++k) {
+                double r = std::sqrt(x * x + d * d);
+                d = b * std::sqrt(std::max(0.0, 1.0 - rs * d * d / (r * r * r)));
+            }
+            glm::vec3 pos(float(x), float(d * std::cos(psi)), float(d * std::sin(psi)));
+            rays[i] = Ray(pos, glm::vec3(1.0f, 0.0f, 0.0f));
+            rays[i].weight = float(weight);
+            return;
+        }
+
+        glm::vec3 pos;
+        pos.x = -3.5f + u(0) * 0.6f;
+        pos.y = -2.0f + u(1) * 4.0f;
+        pos.z = -0.5f + u(2) * 1.0f; // small offset in Z for 3D spread
+
+        glm::vec3 dir = glm::normalize(glm::vec3(1.0f, u(3) * 2.0f - 1.0f, u(4) * 1.0f - 0.5f));
+        rays[i] = Ray(pos, dir);
+    };
+
+    unsigned int workers = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+    workers = static_cast<unsigned int>(std::min<size_t>(workers, std::max<size_t>(1, count / 1024)));
+    auto work = [&](unsigned int worker){
+        for (size_t i = count * worker / workers; i < count * (worker + 1) / workers; ++i) emit(i);
+    };
+    std::vector<std::thread> pool;
+    for (unsigned int w = 1; w < workers; ++w) pool.emplace_back(work, w);
+    work(0);
+    for (auto& t : pool) t.join();
+}
+
+double ImpactEmitter::Sample(double u, double v, double& weight) const{
+    const double critical = 1.5 * std::sqrt(3.0);
+    double bMax = maxImpact, w = std::max(peakWidth, 1e-9);
+    double z0 = std::atan(-critical / w), z1 = std::atan((bMax - critical) / w);
+
+    // Pick a component with u, then invert its CDF with v
+    double b;
+    if (u < peakFraction) b = critical + w * std::tan(z0 + v * (z1 - z0));
+    else b = bMax * std::sqrt(v);
+    b = std::clamp(b, 0.0, bMax);
+
+    // Beam: uniform over the disk; peak: Cauchy truncated to [0, bMax]
+    double beam = 2.0 * b / (bMax * bMax);
+    double z = (b - critical) / w;
+    double peak = 1.0 / (w * (1.0 + z * z) * (z1 - z0));
+    double mixture = (1.0 - peakFraction) * beam + peakFraction * peak;
+    weight = mixture > 0.0 ? beam / mixture : 0.0;
+    return b;
+}
+
+void Simulation::InitializeLenses(int count, double radius, double massRatio){
+    double rs = Ray::ScreenSchwarzschildRadius(blackhole.r_s) * massRatio;
+    std::vector<PointLens> stars;
+    stars.reserve(count);
+    // Its own domain, so the stars do not depend on how many rays were emitted
+    CounterRng rng(seed, RandomDomain::Lenses, 0);
+    while (static_cast<int>(stars.size()) < count) {
+        // Rejection sampling of the ball, keeping clear of the hole itself
+        glm::dvec3 p(2.0 * rng.Uniform() - 1.0, 2.0 * rng.Uniform() - 1.0, 2.0 * rng.Uniform() - 1.0);
+        double d = glm::length(p);
+        if (d > 1.0 || d * radius < 2.0) continue;
+        stars.push_back({ p * radius, rs });
+    }
+    lenses.SetLenses(std::move(stars));
+}
+
+long long Simulation::Step(){
+    return Run(1);
+}
+
+long long Simulation::Run(int steps){
+    // The spin lives on the black hole; Ray::Step reads it from the options
+    options.spin = blackhole.spin;
+    // Rebuilds only if lenses were set or moved since the last frame
+    lenses.Update();
+
+    size_t count = rays.size();
+    unsigned int workers = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+    workers = static_cast<unsigned int>(std::min<size_t>(workers, std::max<size_t>(1, count)));
+
+    if (density.enabled) density.Reserve(workers);
+    if (detector.enabled) detector.Reserve(workers);
+
+    // Each worker records retirements into its own copy, reduced after the run
+    std::vector<RetireStatistics> retiredBy;
+    if (statistics.enabled) {
+        retiredBy.assign(workers, RetireStatistics(statistics.captured.hi, static_cast<int>(statistics.captured.bins.size())));
+    }
+
+    std::vector<long long> stepsPerWorker(workers, 0);
+    auto work = [&](unsigned int worker){
+        size_t begin = count * worker / workers;
+        size_t end = count * (worker + 1) / workers;
+        long long integrated = 0;
+        for (int s = 0; s < steps; ++s) {
+            double t = clock + (s + 1) * stepSize;
+            for (size_t i = begin; i < end; ++i) {
+                Ray& ray = rays[i];
+                glm::vec3 before = ray.position;
+                bool active = !ray.captured && !Escaped(ray);
+                integrated += advance(ray, t);
+                if (statistics.enabled && active) {
+                    if (ray.captured) {
+                        retiredBy[worker].Capture(impactParameter(ray), ray.lambda, ray.weight);
+                    } else if (Escaped(ray)) {
+                        retiredBy[worker].Escape(impactParameter(ray), ray.Deflection(), ray.lambda, ray.weight);
+                    }
+                }
+                if (detector.enabled) detector.Record(worker, before, ray.position, ray.weight);
+                if (density.enabled && !ray.captured && !Escaped(ray)) {
+                    density.Splat(worker, ray.position, ray.weight);
+                }
+            }
+        }
+        stepsPerWorker[worker] = integrated;
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned int w = 1; w < workers; ++w) pool.emplace_back(work, w);
+    work(0);
+    for (auto& t : pool) t.join();
+
+    for (const auto& retired : retiredBy) statistics.Merge(retired);
+    if (density.enabled) density.Merge(workers);
+    if (detector.enabled) detector.Merge();
+    clock += steps * stepSize;
+    if (!particles.Empty()) particles.Run(steps);
+
+    long long total = 0;
+    for (long long n : stepsPerWorker) total += n;
+    return total;
+}
+
+long long Simulation::advance(Ray& ray, double t) const{
+    if (Escaped(ray)) return 0;
+
+    if (multirate.enabled) {
+        // Trails keep one point per frame unless asked otherwise
+        double spacing = options.trailSpacing > 0.0 ? options.trailSpacing : stepSize;
+        long long steps = 0;
+        while (ray.lambda < t && !Escaped(ray)) {
+            double h = multirateStep(ray);
+            deflect(ray, h);
+            if (!ray.Integrate(h, blackhole.r_s, options)) break;
+            ray.EmitTrail(t, spacing);
+            ++steps;
+        }
+        // Rays whose step reaches past t only move along its interpolant
+        ray.EmitTrail(t, spacing);
+        ray.SampleAt(t);
+        return steps;
+    }
+
+    if (!screen.enabled) {
+        deflect(ray, stepSize);
+        return ray.Step(stepSize, blackhole.r_s, options);
+    }
+
+    ray.pendingLambda += stepSize;
+    long long steps = 0;
+    for (;;) {
+        double h = screenStep(ray);
+        if (ray.pendingLambda < h) break;
+        deflect(ray, h);
+        if (!ray.Step(h, blackhole.r_s, options)) {
+            ray.pendingLambda = 0.0;
+            break;
+        }
+        ray.pendingLambda -= h;
+        ++steps;
+        if (Escaped(ray)) break;
+    }
+    return steps;
+}
+
+double Simulation::impactParameter(const Ray& ray) const{
+    if (!ray.invariantsSet || ray.E <= 0.0) return 0.0;
+    double rs = Ray::ScreenSchwarzschildRadius(blackhole.r_s);
+    if (ray.kerrSet) {
+        const KerrConstants& k = ray.kerrConstants;
+        return std::sqrt(k.Lz * k.Lz + std::max(0.0, k.Q)) / k.E / rs;
+    }
+    return std::abs(ray.L) / ray.E / rs;
+}
+
+void Simulation::deflect(Ray& ray, double h) const{
+    if (lenses.Empty() || ray.captured) return;
+    glm::dvec3 v = ray.Velocity();
+    if (glm::dot(v, v) <= 0.0) return;
+    // Kick, then the step drifts along the deflected geodesic
+    ray.Deflect(lenses.Acceleration(ray.StatePosition(), v) * h, blackhole.r_s, options);
+}
+
+bool Simulation::inFarZone(const Ray& ray) const{
+    return options.farRadius > 0.0 && options.spacetime == Spacetime::Schwarzschild && blackhole.spin == 0.0 &&
+           ray.r > options.farRadius * Ray::ScreenSchwarzschildRadius(blackhole.r_s);
+}
+
+double Simulation::stepCap(const Ray& ray, double scale) const{
+    if (!inFarZone(ray)) return scale * ray.r;
+    double y[4] = { ray.r, ray.phi, ray.dr, ray.dphi };
+    double reach = Ray::FarZoneReach(y, options.farRadius * Ray::ScreenSchwarzschildRadius(blackhole.r_s));
+    // Never below the near-zone cap, so rays do not stall at the boundary
+    return std::max(scale * ray.r, std::min(options.farStepScale * ray.r, reach));
+}
+
+double Simulation::screenStep(const Ray& ray) const{
+    double cap = stepCap(ray, screen.maxStepScale);
+
+    // Depth in front of the camera; rays behind it only get the accuracy cap
+    const glm::mat4& v = screen.view;
+    double depth = -(v[0][2] * ray.position.x + v[1][2] * ray.position.y + v[2][2] * ray.position.z + v[3][2]);
+    if (depth <= 0.0) return cap;
+    depth = std::max(depth, 0.1);
+
+    // Pixels per world unit at this depth, and world units per unit of λ
+    double pixelsPerUnit = 0.5 * screen.viewportHeight * screen.projection[1][1] / depth;
+    double speed = std::sqrt(ray.dr * ray.dr + ray.r * ray.r * ray.dphi * ray.dphi);
+    if (speed <= 0.0) return cap;
+
+    return std::min(cap, screen.pixels / (pixelsPerUnit * speed));
+}
+
+double Simulation::multirateStep(const Ray& ray) const{
+    double cap = stepCap(ray, multirate.maxStepScale);
+    if (screen.enabled) cap = std::min(cap, screenStep(ray));
+    // Far zone steps follow the bending analytically
+    if (inFarZone(ray)) return cap;
+
+    // Turning rate of the direction of travel. On the null cone the in-plane
+    // acceleration is purely radial, -1.5 rs dphi² (see Ray::regularRHS), so
+    // |x' × x''| / |x'|² = 1.5 rs r |dphi|³ / v².
+    double rs = Ray::ScreenSchwarzschildRadius(blackhole.r_s);
+    double v2 = ray.dr * ray.dr + ray.r * ray.r * ray.dphi * ray.dphi;
+    double turnRate = 1.5 * rs * ray.r * std::abs(ray.dphi * ray.dphi * ray.dphi) / v2;
+    if (!(turnRate > 0.0)) return cap;
+
+    return std::min(cap, multirate.turnAngle / turnRate);
+}
+
+void Simulation::SetView(const glm::mat4& view, const glm::mat4& projection, int viewportHeight){
+    screen.view = view;
+    screen.projection = projection;
+    screen.viewportHeight = viewportHeight;
+    density.viewProjection = projection * view;
+}
+
+bool Simulation::Escaped(const Ray& ray) const{
+    return !ray.captured && ray.r > escapeRadius && ray.dr > 0.0;
+}
+
+RetireStats Simulation::Census() const{
+    RetireStats stats;
+    for (const auto& ray : rays) {
+        if (ray.captured) {
+            stats.captured++;
+            stats.capturedWeight += ray.weight;
+        } else if (Escaped(ray)) {
+            stats.escaped++;
+            stats.escapedWeight += ray.weight;
+        } else {
+            stats.active++;
+            stats.activeWeight += ray.weight;
+        }
+    }
+    return stats;
+}
+
+InvariantStats Simulation::Invariants() const{
+    InvariantStats stats;
+    for (const auto& ray : rays) {
+        if (ray.captured || Escaped(ray) || !ray.invariantsSet) continue;
+        double null, energy, momentum;
+        ray.Invariants(blackhole.r_s, null, energy, momentum, options);
+        stats.maxNullResidual = std::max(stats.maxNullResidual, null);
+        stats.maxEnergyDrift = std::max(stats.maxEnergyDrift, energy);
+        stats.maxMomentumDrift = std::max(stats.maxMomentumDrift, momentum);
+        stats.meanNullResidual += null;
+        stats.meanEnergyDrift += energy;
+        stats.meanMomentumDrift += momentum;
+        stats.rays++;
+    }
+    if (stats.rays > 0) {
+        stats.meanNullResidual /= stats.rays;
+        stats.meanEnergyDrift /= stats.rays;
+        stats.meanMomentumDrift /= stats.rays;
+    }
+    return stats;
+}
+
+void Simulation::Draw(Renderer& renderer) const{
+    renderer.DrawBlackHole(blackhole);
+    if (density.enabled) renderer.DrawDensity(density);
+    else renderer.DrawRays(rays);
+    renderer.DrawParticles(particles);
+}
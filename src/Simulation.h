@@ -0,0 +1,142 @@
+#pragma once
+#include "core_config.h"
+#include "BlackHole.h"
+#include "DensityGrid.h"
+#include "DetectorScreen.h"
+#include "LensTree.h"
+#include "ParticleSwarm.h"
+#include "Random.h"
+#include "Ray.h"
+#include "Renderer.h"
+#include "StreamingStats.h"
+
+// How many rays have left the simulation and how
+struct RetireStats{
+    long long captured = 0;     // reached the horizon
+    long long escaped = 0;      // outgoing beyond escapeRadius
+    long long active = 0;       // still being integrated
+    // The same, summed over Ray::weight: estimates for the unbiased beam
+    double capturedWeight = 0.0, escapedWeight = 0.0, activeWeight = 0.0;
+};
+
+// Invariant errors over the rays that are still integrated (see
+// Ray::InvariantErrors); all relative, zero for an exact integrator
+struct InvariantStats{
+    double maxNullResidual = 0.0, meanNullResidual = 0.0;
+    double maxEnergyDrift = 0.0, meanEnergyDrift = 0.0;
+    double maxMomentumDrift = 0.0, meanMomentumDrift = 0.0;
+    long long rays = 0;
+};
+
+// Screen-space step control. Each frame every ray still owes stepSize of
+// affine parameter, but pays it off in steps as large as the view allows:
+// no step may move the ray more than `pixels` on screen. Zoomed-out views
+// take proportionally fewer, larger steps; a ray lags its exact position by
+// less than that tolerance.
+struct ScreenStepControl{
+    bool enabled = false;
+    float pixels = 1.0f;            // max projected motion of one step
+    double maxStepScale = 0.1;      // accuracy cap on a step, relative to r
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+    int viewportHeight = 600;
+};
+
+// Multi-rate stepping. Every ray runs its own affine clock with a step fitted
+// to how sharply it bends there. Each frame only the rays whose current step
+// ends before the frame time are integrated; the others are sampled from the
+// dense output of the step they are in. Nearly straight rays far from the
+// hole take a step every many frames.
+struct MultirateControl{
+    bool enabled = false;
+    double turnAngle = 0.01;        // max change of direction over one step, radians
+    double maxStepScale = 0.1;      // accuracy cap on a step, relative to r
+};
+
+// Emission by impact parameter. Rays leave a disk of radius maxImpact facing
+// +x, as a parallel beam from the left, so each ray's b = L/E is set
+// directly. Uniform in area, almost all of them fly past; here a fraction
+// peakFraction of b is drawn instead from a Cauchy peak at the critical
+// b_c = 3√3/2 r_s, where rays wind around the photon sphere. Ray::weight,
+// the ratio of the beam's density to this mixture's, undoes the bias.
+struct ImpactEmitter{
+    bool enabled = false;
+    double peakFraction = 0.75;
+    double peakWidth = 0.05;        // Cauchy half width, units of r_s
+    double maxImpact = 4.0;         // beam radius, units of r_s
+    double startX = -3.5;           // plane the rays start from, screen units
+
+    // Impact parameter (units of r_s) from the two uniforms u, v; weight is
+    // set to beam density / sampling density at that b
+    double Sample(double u, double v, double& weight) const;
+};
+
+// GL-free simulation: the black hole, its rays and how they are advanced.
+// Drawing goes through a Renderer, so the same loop runs with the GL
+// renderer in the app or with NullRenderer in benchmarks and batch runs.
+struct Simulation{
+    BlackHole blackhole;
+    std::vector<Ray> rays;
+    double stepSize = 0.01;     // affine step per frame
+    StepOptions options;        // integrator, projection, horizon regularization
+    double escapeRadius = 40.0; // screen units; outgoing rays past this are retired
+    unsigned int threads = 1;   // 0 = all cores
+    ScreenStepControl screen;   // fixed steps of stepSize unless screen.enabled
+    MultirateControl multirate; // per-ray clocks; screen, if enabled, caps their steps
+    double clock = 0.0;         // frame time in affine parameter, for multirate
+    LensTree lenses;            // weak-field point lenses (stars) around the hole; empty = none
+    ParticleSwarm particles;    // infalling matter, advanced and drawn with the rays; empty = none
+    uint64_t seed = 1;          // rays, lenses and particles are reproducible from it
+    Sampling sampling = Sampling::Random; // how InitializeRays covers the emitter
+    DensityGrid density;        // if enabled, every frame splats the active rays into it and Draw shows it instead of trails
+    DetectorScreen detector;    // if enabled, bins every frame's crossings of the detector plane
+    RetireStatistics statistics; // if enabled, capture, deflection and escape time of every ray as it retires
+    ImpactEmitter impact;       // if enabled, InitializeRays emits a beam by impact parameter instead of the slab
+
+    Simulation(const BlackHole& blackhole) : blackhole(blackhole) {}
+
+    // Emit numRays rays from a slab left of the black hole, heading right.
+    // Ray i takes coordinates i of the sampling sequence, so the rays are
+    // built in parallel and a low-discrepancy sequence covers the slab and
+    // the directions evenly at any count.
+    void InitializeRays(int numRays);
+    // Scatter count stars uniformly through a sphere of radius (screen units)
+    // around the hole, each with massRatio times its r_s, as lenses
+    void InitializeLenses(int count, double radius, double massRatio);
+
+    // Advance every active ray by one step. Returns the number of ray steps
+    // actually integrated (retired rays are skipped).
+    long long Step();
+
+    // Advance every active ray by steps steps. Rays are independent, so each
+    // worker takes a contiguous block of rays for the whole run. Particles,
+    // if any, then advance by as many of their own frames.
+    long long Run(int steps);
+
+    // Camera the rays are drawn with, for screen-space stepping
+    void SetView(const glm::mat4& view, const glm::mat4& projection, int viewportHeight);
+
+    bool Escaped(const Ray& ray) const;
+    RetireStats Census() const;
+    InvariantStats Invariants() const;
+
+    void Draw(Renderer& renderer) const;
+
+private:
+    // Accuracy cap on a step: scale * r, or beyond options.farRadius an
+    // analytic jump of up to options.farStepScale * r that stops where the
+    // strong field begins
+    double stepCap(const Ray& ray, double scale) const;
+    bool inFarZone(const Ray& ray) const;
+    // Largest step for ray under the screen tolerance and the accuracy cap
+    double screenStep(const Ray& ray) const;
+    // b = L/E of ray in units of r_s (sqrt(Lz² + Q)/E for Kerr); 0 before its first step
+    double impactParameter(const Ray& ray) const;
+    // Impulse from the point lenses over a step of h, applied before the step
+    void deflect(Ray& ray, double h) const;
+    // Step for ray from its local bending rate, for multirate stepping
+    double multirateStep(const Ray& ray) const;
+    // One frame of a ray ending at frame time t: fixed step, pay off pending λ
+    // in screen-sized steps, or catch the ray's own clock up with t
+    long long advance(Ray& ray, double t) const;
+};
@@ -0,0 +1,147 @@
+#include "StreamingStats.h"
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+
+void StreamingHistogram::Add(double x, double w){
+    if (w <= 0.0) return;
+    if (x < lo) underflow += w;
+    else if (x >= hi) overflow += w;
+    else if (!bins.empty()) {
+        size_t i = static_cast<size_t>((x - lo) / (hi - lo) * bins.size());
+        bins[std::min(i, bins.size() - 1)] += w;
+    }
+
+    // Weighted Welford
+    weight += w;
+    double delta = x - mean;
+    mean += delta * w / weight;
+    m2 += w * delta * (x - mean);
+}
+
+void StreamingHistogram::Merge(const StreamingHistogram& other){
+    if (other.weight <= 0.0) return;
+    for (size_t i = 0; i < bins.size() && i < other.bins.size(); ++i) bins[i] += other.bins[i];
+    underflow += other.underflow;
+    overflow += other.overflow;
+
+    double total = weight + other.weight;
+    double delta = other.mean - mean;
+    m2 += other.m2 + delta * delta * weight * other.weight / total;
+    mean += delta * other.weight / total;
+    weight = total;
+}
+
+void QuantileSketch::Add(double x, double w){
+    if (w <= 0.0) return;
+    total += w;
+    if (x <= 0.0) {
+        zeros += w;
+        return;
+    }
+    double gamma = (1.0 + alpha) / (1.0 - alpha);
+    buckets[static_cast<int>(std::ceil(std::log(x) / std::log(gamma)))] += w;
+}
+
+void QuantileSketch::Merge(const QuantileSketch& other){
+    for (const auto& [index, w] : other.buckets) buckets[index] += w;
+    zeros += other.zeros;
+    total += other.total;
+}
+
+double QuantileSketch::Quantile(double q) const{
+    if (total <= 0.0) return 0.0;
+    double rank = std::clamp(q, 0.0, 1.0) * total;
+    if (rank <= zeros) return 0.0;
+
+    // Bucket i holds (gamma^(i-1), gamma^i]; its midpoint in relative terms
+    // is 2 gamma^i / (gamma + 1), within alpha of everything in it
+    double gamma = (1.0 + alpha) / (1.0 - alpha);
+    double seen = zeros;
+    int last = 0;
+    for (const auto& [index, w] : buckets) {
+        seen += w;
+        last = index;
+        if (seen >= rank) break;
+    }
+    return 2.0 * std::pow(gamma, last) / (gamma + 1.0);
+}
+
+RetireStatistics::RetireStatistics(double maxImpact, int impactBins)
+    : captured(0.0, maxImpact, impactBins), escaped(0.0, maxImpact, impactBins),
+      deflection(0.0, 2.0 * 3.14159265358979, 180), deflectionByImpact(impactBins, StreamingHistogram(0.0, 0.0, 0)) {}
+
+void RetireStatistics::Capture(double b, double lambda, double weight){
+    captured.Add(b, weight);
+    captureTime.Add(lambda, weight);
+}
+
+void RetireStatistics::Escape(double b, double deflectionAngle, double lambda, double weight){
+    escaped.Add(b, weight);
+    deflection.Add(deflectionAngle, weight);
+    deflectionQuantiles.Add(deflectionAngle, weight);
+    escapeTime.Add(lambda, weight);
+    if (b >= escaped.lo && b < escaped.hi && !deflectionByImpact.empty()) {
+        size_t i = static_cast<size_t>((b - escaped.lo) / (escaped.hi - escaped.lo) * deflectionByImpact.size());
+        deflectionByImpact[std::min(i, deflectionByImpact.size() - 1)].Add(deflectionAngle, weight);
+    }
+}
+
+void RetireStatistics::Merge(const RetireStatistics& other){
+    captured.Merge(other.captured);
+    escaped.Merge(other.escaped);
+    deflection.Merge(other.deflection);
+    for (size_t i = 0; i < deflectionByImpact.size() && i < other.deflectionByImpact.size(); ++i) {
+        deflectionByImpact[i].Merge(other.deflectionByImpact[i]);
+    }
+    deflectionQuantiles.Merge(other.deflectionQuantiles);
+    escapeTime.Merge(other.escapeTime);
+    captureTime.Merge(other.captureTime);
+}
+
+static void writeList(std::ostream& out, const std::vector<double>& values){
+    out << "[";
+    for (size_t i = 0; i < values.size(); ++i) out << (i ? ", " : "") << values[i];
+    out << "]";
+}
+
+static void writeQuantiles(std::ostream& out, const QuantileSketch& sketch){
+    out << "{\"weight\": " << sketch.Weight() << ", \"p05\": " << sketch.Quantile(0.05)
+        << ", \"p50\": " << sketch.Quantile(0.5) << ", \"p95\": " << sketch.Quantile(0.95) << "}";
+}
+
+void RetireStatistics::Write(std::ostream& out) const{
+    double capturedWeight = captured.weight, escapedWeight = escaped.weight;
+    double retired = capturedWeight + escapedWeight;
+
+    // Per b bin: capture fraction and mean deflection of the escapes
+    std::vector<double> impact, captureFraction, meanDeflection, deflectionSpread;
+    for (size_t i = 0; i < captured.bins.size(); ++i) {
+        impact.push_back(captured.lo + (i + 0.5) * (captured.hi - captured.lo) / captured.bins.size());
+        double total = captured.bins[i] + escaped.bins[i];
+        captureFraction.push_back(total > 0.0 ? captured.bins[i] / total : 0.0);
+        const StreamingHistogram& d = deflectionByImpact[i];
+        meanDeflection.push_back(d.mean);
+        deflectionSpread.push_back(std::sqrt(d.Variance()));
+    }
+
+    out << "{\n  \"retired\": " << retired << ", \"captured\": " << capturedWeight << ", \"escaped\": " << escapedWeight
+        << ", \"capture_fraction\": " << (retired > 0.0 ? capturedWeight / retired : 0.0) << ",\n";
+    out << "  \"impact\": ";
+    writeList(out, impact);
+    out << ",\n  \"capture_fraction_by_impact\": ";
+    writeList(out, captureFraction);
+    out << ",\n  \"deflection_mean_by_impact\": ";
+    writeList(out, meanDeflection);
+    out << ",\n  \"deflection_stddev_by_impact\": ";
+    writeList(out, deflectionSpread);
+    out << ",\n  \"deflection_histogram\": {\"lo\": " << deflection.lo << ", \"hi\": " << deflection.hi << ", \"bins\": ";
+    writeList(out, deflection.bins);
+    out << "},\n  \"deflection\": ";
+    writeQuantiles(out, deflectionQuantiles);
+    out << ",\n  \"escape_time\": ";
+    writeQuantiles(out, escapeTime);
+    out << ",\n  \"capture_time\": ";
+    writeQuantiles(out, captureTime);
+    out << "\n}\n";
+}
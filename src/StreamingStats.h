@@ -0,0 +1,69 @@
+#pragma once
+#include <iosfwd>
+#include <map>
+#include <vector>
+
+// Online, mergeable accumulators for science runs: distributions are built
+// as rays retire, so nothing about a trajectory has to be kept. Every
+// accumulator is weighted (Ray::weight) and has Merge, so workers fill their
+// own copies and one reduction combines them.
+
+// Fixed-width bins over [lo, hi) plus under- and overflow, and the running
+// mean and variance of everything added (Welford, merged with Chan et al.)
+struct StreamingHistogram{
+    double lo = 0.0, hi = 1.0;
+    std::vector<double> bins;
+    double underflow = 0.0, overflow = 0.0;
+    double weight = 0.0, mean = 0.0, m2 = 0.0;
+
+    StreamingHistogram() = default;
+    StreamingHistogram(double lo, double hi, int count) : lo(lo), hi(hi), bins(count, 0.0) {}
+
+    void Add(double x, double w = 1.0);
+    void Merge(const StreamingHistogram& other);
+    double Variance() const { return weight > 0.0 ? m2 / weight : 0.0; }
+};
+
+// Quantiles to a relative accuracy alpha (DDSketch, Masson et al. 2019):
+// positive values go to logarithmic buckets of ratio (1 + alpha)/(1 - alpha),
+// so any quantile is returned within alpha of the true value, in memory
+// logarithmic in the range of the data. Merging adds buckets.
+struct QuantileSketch{
+    double alpha = 0.01;
+
+    QuantileSketch() = default;
+    explicit QuantileSketch(double alpha) : alpha(alpha) {}
+
+    void Add(double x, double w = 1.0);
+    void Merge(const QuantileSketch& other);
+    // q in [0, 1]; 0 when empty. Values <= 0 count as 0.
+    double Quantile(double q) const;
+    double Weight() const { return total; }
+
+private:
+    std::map<int, double> buckets;
+    double zeros = 0.0;
+    double total = 0.0;
+};
+
+// What happened to the rays, by impact parameter b (units of r_s): how much
+// weight was captured or escaped, and for escapes the deflection angle.
+// Plus time to escape or capture (affine parameter) over all rays.
+struct RetireStatistics{
+    bool enabled = false;               // Simulation records retiring rays only when set
+    StreamingHistogram captured;        // weight by b
+    StreamingHistogram escaped;         // weight by b
+    StreamingHistogram deflection;      // escaped rays: deflection angle (rad, unwrapped, loops above 2π overflow), by value
+    std::vector<StreamingHistogram> deflectionByImpact; // one per b bin of captured/escaped
+    QuantileSketch deflectionQuantiles;
+    QuantileSketch escapeTime, captureTime;
+
+    explicit RetireStatistics(double maxImpact = 10.0, int impactBins = 50);
+
+    void Capture(double b, double lambda, double weight);
+    void Escape(double b, double deflectionAngle, double lambda, double weight);
+    void Merge(const RetireStatistics& other);
+
+    // Summary as JSON, readable at any point of a run
+    void Write(std::ostream& out) const;
+};
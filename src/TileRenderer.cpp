@@ -0,0 +1,121 @@
+#include "TileRenderer.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+RenderStats TileRenderer::Render(const LensingCamera& camera, std::vector<glm::vec3>& image) const{
+    image.assign(static_cast<size_t>(camera.width) * camera.height, glm::vec3(0.0f));
+
+    int tilesX = (camera.width + tileSize - 1) / tileSize;
+    int tilesY = (camera.height + tileSize - 1) / tileSize;
+    int tileCount = tilesX * tilesY;
+
+    unsigned int workers = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+    workers = std::min(workers, static_cast<unsigned int>(std::max(1, tileCount)));
+
+    // Tiles are handed out dynamically: tiles through the shadow finish fast,
+    // tiles on the photon ring are slow, so a static split would idle cores.
+    std::atomic<int> nextTile{ 0 };
+    std::vector<long long> raysPerWorker(workers, 0), stepsPerWorker(workers, 0);
+
+    auto start = std::chrono::steady_clock::now();
+    auto work = [&](unsigned int worker){
+        long long rays = 0, steps = 0;
+        for (int tile = nextTile++; tile < tileCount; tile = nextTile++) {
+            rays += RenderTile(camera, (tile % tilesX) * tileSize, (tile / tilesX) * tileSize, image, steps);
+        }
+        raysPerWorker[worker] = rays;
+        stepsPerWorker[worker] = steps;
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned int w = 1; w < workers; ++w) pool.emplace_back(work, w);
+    work(0);
+    for (auto& t : pool) t.join();
+
+    RenderStats stats;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.pixels = static_cast<long long>(image.size()) * samplesPerPixel;
+    for (unsigned int w = 0; w < workers; ++w) {
+        stats.rays += raysPerWorker[w];
+        stats.steps += stepsPerWorker[w];
+    }
+    return stats;
+}
+
+static glm::vec3 shadeDifferential(const TraceResult& hit, Shading shading){
+    if (hit.captured) return glm::vec3(0.0f);
+    if (shading == Shading::Magnification) {
+        float level = 0.5f + 0.25f * static_cast<float>(std::log10(std::abs(hit.magnification)));
+        return glm::vec3(glm::clamp(level, 0.0f, 1.0f));
+    }
+    return LensingTracer::Background(hit.direction, hit.dDirdx, hit.dDirdy);
+}
+
+long long TileRenderer::RenderTile(const LensingCamera& camera, int x0, int y0, std::vector<glm::vec3>& image,
+                                   long long& steps) const{
+    constexpr int N = LensingTracer::PacketSize;
+    int x1 = std::min(x0 + tileSize, camera.width);
+    int y1 = std::min(y0 + tileSize, camera.height);
+
+    glm::vec3 dirs[N];
+    TraceResult hits[N];
+    int pixel[N];
+    long long rays = 0;
+    std::vector<glm::vec3> colors;
+
+    for (int sample = 0; sample < samplesPerPixel; ++sample) {
+        glm::vec2 jitter = LensingTracer::SampleOffset(sample);
+
+        if (shading != Shading::Sky) {
+            // One differential ray per pixel instead of a packet
+            for (int y = y0; y < y1; ++y) {
+                for (int x = x0; x < x1; ++x) {
+                    glm::vec3 dDirdx, dDirdy;
+                    tracer.PixelDifferentials(camera, x + jitter.x, y + jitter.y, dDirdx, dDirdy);
+                    TraceResult hit = tracer.TraceDifferential(
+                        camera.position, tracer.PixelDirection(camera, x + jitter.x, y + jitter.y), dDirdx, dDirdy);
+                    image[y * camera.width + x] += shadeDifferential(hit, shading) / float(samplesPerPixel);
+                    steps += hit.steps;
+                }
+            }
+            rays += static_cast<long long>(x1 - x0) * (y1 - y0);
+            continue;
+        }
+
+        if (adaptive) {
+            rays += sampler.SampleTile(tracer, camera, jitter, x0, y0, x1, y1, colors, steps);
+            for (int y = y0; y < y1; ++y) {
+                for (int x = x0; x < x1; ++x) {
+                    image[y * camera.width + x] += colors[(y - y0) * (x1 - x0) + (x - x0)] / float(samplesPerPixel);
+                }
+            }
+            continue;
+        }
+
+        // Neighbouring pixels of a row share a packet, so their rays stay close
+        // and the lanes tend to finish after a similar number of steps
+        int count = 0;
+        auto flush = [&](){
+            tracer.TracePacket(camera.position, dirs, count, hits);
+            for (int i = 0; i < count; ++i) {
+                image[pixel[i]] += LensingTracer::Shade(hits[i]) / float(samplesPerPixel);
+                steps += hits[i].steps;
+            }
+            rays += count;
+            count = 0;
+        };
+
+        for (int y = y0; y < y1; ++y) {
+            for (int x = x0; x < x1; ++x) {
+                dirs[count] = tracer.PixelDirection(camera, x + jitter.x, y + jitter.y);
+                pixel[count] = y * camera.width + x;
+                if (++count == N) flush();
+            }
+        }
+        if (count > 0) flush();
+    }
+    return rays;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "LensingTracer.h"
+#include "AdaptiveSampler.h"
+#include <vector>
+
+// Throughput of one rendered frame
+struct RenderStats{
+    long long pixels = 0;   // pixels shaded (times samples per pixel)
+    long long rays = 0;     // geodesics traced
+    long long steps = 0;    // RK4 steps over all rays
+    double seconds = 0.0;   // wall time
+
+    double RaysPerSecond() const { return seconds > 0.0 ? rays / seconds : 0.0; }
+    double StepsPerSecond() const { return seconds > 0.0 ? steps / seconds : 0.0; }
+};
+
+// What a rendered pixel shows
+enum class Shading{
+    Sky,            // point sampled lensed sky
+    FilteredSky,    // sky filtered over the pixel footprint from ray differentials
+    Magnification,  // log10 |magnification| as gray (0.5 = unlensed), black in the shadow
+};
+
+// Headless CPU renderer for the lensed sky. The image is cut into square tiles
+// that worker threads pull from a shared counter; inside a tile, pixels are
+// traced in packets of LensingTracer::PacketSize rays. Uses the same camera,
+// tracer and shading as LensedBackground, so the result matches the
+// interactive view for the same orbit camera.
+struct TileRenderer{
+    LensingTracer tracer;
+    int tileSize = 32;
+    int samplesPerPixel = 1;    // jittered samples per pixel, averaged
+    unsigned int threads = 0;   // 0 = std::thread::hardware_concurrency()
+    Shading shading = Shading::Sky;
+
+    // Trace a coarse grid and refine only near the shadow edge and photon
+    // ring instead of tracing every pixel. Point sampled, Shading::Sky only.
+    bool adaptive = false;
+    AdaptiveSampler sampler;
+
+    TileRenderer(double r_s_screen) : tracer(r_s_screen) {}
+
+    // Render camera.width x camera.height pixels into image (row 0 at the bottom)
+    RenderStats Render(const LensingCamera& camera, std::vector<glm::vec3>& image) const;
+
+private:
+    // Returns the number of rays traced for the tile
+    long long RenderTile(const LensingCamera& camera, int x0, int y0, std::vector<glm::vec3>& image,
+                         long long& steps) const;
+};
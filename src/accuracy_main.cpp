@@ -0,0 +1,293 @@
+// Accuracy versus cost of the ray integrators. Shoots rays past the black
+// hole over a sweep of impact parameters and compares the angle swept between
+// entering and leaving a sphere of radius R with the exact Schwarzschild value
+// (an incomplete elliptic integral of the first kind). Also tracks how far
+// the state drifts from the null cone and from the initial E and L.
+// Prints one row per integrator and step size, with the Pareto-optimal rows
+// (no other row is both cheaper and more accurate) marked.
+#include "Ray.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Exact orbit of a photon with impact parameter b in u = 1/r:
+// (du/dphi)² = rs u³ - u² + 1/b² = rs (u - u1)(u - u2)(u - u3), u1 < 0 < u2 < u3,
+// with u2 = 1/periapsis. Needs b above the critical 3√3/2 rs.
+struct ExactOrbit{
+    double rs, b;
+    double u1, u2, u3;
+
+    ExactOrbit(double rs, double b) : rs(rs), b(b){
+        // Trigonometric roots of u³ - u²/rs + 1/(rs b²) after u = t + 1/(3 rs)
+        double p = -1.0 / (3.0 * rs * rs);
+        double q = -2.0 / (27.0 * rs * rs * rs) + 1.0 / (rs * b * b);
+        double m = 2.0 * std::sqrt(-p / 3.0);
+        double theta = std::acos(std::clamp(3.0 * q / (p * m), -1.0, 1.0)) / 3.0;
+        double roots[3];
+        for (int k = 0; k < 3; ++k)
+            roots[k] = m * std::cos(theta - 2.0 * M_PI * k / 3.0) + 1.0 / (3.0 * rs);
+        std::sort(roots, roots + 3);
+        u1 = roots[0]; u2 = roots[1]; u3 = roots[2];
+    }
+
+    // Angle swept going from radius r to periapsis,
+    // ∫_u^u2 du / sqrt(rs (u3 - u)(u2 - u)(u - u1)) = 2 F(ψ, k) / sqrt(rs (u3 - u1))
+    double AngleToPeriapsis(double r) const{
+        double u = std::min(1.0 / r, u2);
+        double k = std::sqrt((u2 - u1) / (u3 - u1));
+        double s = std::sqrt(std::clamp((u3 - u1) * (u2 - u) / ((u2 - u1) * (u3 - u)), 0.0, 1.0));
+        return 2.0 * std::ellint_1(k, std::asin(s)) / std::sqrt(rs * (u3 - u1));
+    }
+};
+
+struct TrajectoryError{
+    double angle = 0.0;         // |numerical - exact| swept angle, radians
+    double nullDrift = 0.0;     // max |g(v, v)| / E², 0 on the null cone
+    double energyDrift = 0.0;   // max |E(state) - E| / E, E(state) from the null condition
+    double momentumDrift = 0.0; // max |r² dphi - L| / L
+    long long steps = 0;
+    long long farSteps = 0;     // analytic far zone steps among them, no right hand side evaluations
+};
+
+// Integrates one ray from r = R, inbound with impact parameter b, until it
+// is back outside R (moving out) and compares with the exact orbit.
+static TrajectoryError traceRay(const StepOptions& options, double rs, double b, double R, double h,
+                                long long maxSteps){
+    const double E = 1.0;
+    const double L = b * E;
+    double f0 = 1.0 - rs / R;
+    double y[4] = { R, 0.0, -std::sqrt(E * E - f0 * L * L / (R * R)), L / (R * R) };
+
+    TrajectoryError error;
+    auto track = [&]{
+        double null, energy, momentum;
+        Ray::InvariantErrors(y, E, L, rs, null, energy, momentum);
+        error.nullDrift = std::max(error.nullDrift, null);
+        error.energyDrift = std::max(error.energyDrift, energy);
+        error.momentumDrift = std::max(error.momentumDrift, momentum);
+    };
+
+    for (; error.steps < maxSteps; ++error.steps) {
+        // In the far zone the analytic step takes large jumps, as in Simulation
+        double step = h;
+        if (options.farRadius > 0.0 && y[0] > options.farRadius * rs) {
+            step = std::max(h, std::min(options.farStepScale * y[0], Ray::FarZoneReach(y, options.farRadius * rs)));
+            ++error.farSteps;
+        }
+        Ray::Advance(options, y, E, L, step, rs);
+        track();
+        if (y[0] >= R && y[2] > 0.0) break;
+    }
+
+    // Exact angle from R in to periapsis and back out to the final radius
+    ExactOrbit orbit(rs, b);
+    double exact = orbit.AngleToPeriapsis(R) + orbit.AngleToPeriapsis(y[0]);
+    error.angle = std::abs(y[1] - exact);
+    return error;
+}
+
+struct Row{
+    StepOptions options;
+    double stepSize;
+    double rhsPerRay = 0.0;     // mean right hand side evaluations per ray
+    double meanAngle = 0.0, maxAngle = 0.0;
+    double nullDrift = 0.0, energyDrift = 0.0, momentumDrift = 0.0;
+    bool pareto = false;
+};
+
+static bool parseDoubles(const char* value, std::vector<double>& list){
+    list.clear();
+    std::stringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        double x = std::strtod(item.c_str(), nullptr);
+        if (!(x > 0.0)) return false;
+        list.push_back(x);
+    }
+    return !list.empty();
+}
+
+static void printUsage(const char* program){
+    std::cout <<
+        "Usage: " << program << " [options]\n"
+        "  --steps LIST        affine step sizes, screen units (0.0025,...,0.2,0.5)\n"
+        "  --integrators LIST  comma separated integrator names (all)\n"
+        "  --impacts N         impact parameters, from just above critical to 20 rs (16)\n"
+        "  --closest X         smallest (b - b_crit) / b_crit; smaller values wind longer (0.02)\n"
+        "  --radius R          start/end radius in units of rs (100)\n"
+        "  --project           also run every setting with constraint projection\n"
+        "  --regularize        also run every setting with the horizon-regular form\n"
+        "  --far R             also run every setting with analytic steps beyond R rs\n"
+        "  --tolerance RAD     also report the cheapest row with max error below RAD\n"
+        "  --csv FILE          write the table as CSV as well\n";
+}
+
+int main(int argc, char** argv){
+    std::vector<double> stepSizes = { 0.0025, 0.005, 0.01, 0.02, 0.05, 0.1, 0.2, 0.5 };
+    std::vector<Integrator> integrators = Ray::Integrators();
+    int impacts = 16;
+    double radiusRs = 100.0, tolerance = 0.0, closest = 0.02;
+    std::string csvPath;
+    bool project = false, regularize = false;
+    double farRadius = 0.0;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        }
+        if (arg == "--project") {
+            project = true;
+            continue;
+        }
+        if (arg == "--regularize") {
+            regularize = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return EXIT_FAILURE;
+        }
+        const char* value = argv[++i];
+
+        if (arg == "--steps") {
+            if (!parseDoubles(value, stepSizes)) {
+                std::cerr << "Expected a comma separated list of positive step sizes." << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (arg == "--integrators") {
+            integrators.clear();
+            std::stringstream stream(value);
+            std::string name;
+            while (std::getline(stream, name, ',')) {
+                Integrator integrator;
+                if (!Ray::ParseIntegrator(name, integrator)) {
+                    std::cerr << "Unknown integrator " << name << std::endl;
+                    return EXIT_FAILURE;
+                }
+                integrators.push_back(integrator);
+            }
+        }
+        else if (arg == "--impacts") impacts = std::atoi(value);
+        else if (arg == "--closest") closest = std::strtod(value, nullptr);
+        else if (arg == "--radius") radiusRs = std::strtod(value, nullptr);
+        else if (arg == "--far") farRadius = std::strtod(value, nullptr);
+        else if (arg == "--tolerance") tolerance = std::strtod(value, nullptr);
+        else if (arg == "--csv") csvPath = value;
+        else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (impacts <= 0 || radiusRs <= 20.0 || integrators.empty() || !(closest > 0.0) || farRadius < 0.0) {
+        std::cerr << "Need at least one integrator and impact parameter, a radius above 20 rs and a positive --closest and --far." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Same units as the simulation: screen units with rs = 0.6
+    const double rs = Ray::ScreenSchwarzschildRadius(1.0);
+    const double R = radiusRs * rs;
+    const double bCritical = 1.5 * std::sqrt(3.0) * rs;
+
+    // Geometric spacing of b - b_crit: dense near the photon sphere, where
+    // rays wind around the hole and errors grow fastest
+    std::vector<double> impactParameters;
+    double nearest = closest * bCritical, farthest = 20.0 * rs - bCritical;
+    for (int i = 0; i < impacts; ++i) {
+        double t = impacts > 1 ? double(i) / (impacts - 1) : 0.0;
+        impactParameters.push_back(bCritical + nearest * std::pow(farthest / nearest, t));
+    }
+
+    std::vector<Row> rows;
+    std::vector<StepOptions> schemes;
+    for (Integrator integrator : integrators) {
+        for (int variant = 0; variant < 8; ++variant) {
+            StepOptions options;
+            options.integrator = integrator;
+            options.projectInvariants = variant & 1;
+            options.regularizeHorizon = variant & 2;
+            options.farRadius = (variant & 4) ? farRadius : 0.0;
+            if ((options.projectInvariants && !project) || (options.regularizeHorizon && !regularize) ||
+                ((variant & 4) && farRadius <= 0.0)) continue;
+            schemes.push_back(options);
+        }
+    }
+
+    for (const StepOptions& options : schemes) {
+        for (double h : stepSizes) {
+            Row row{ options, h };
+            // Enough steps for a few windings at the smallest impact parameter
+            long long maxSteps = static_cast<long long>(50.0 * R / h);
+            long long totalSteps = 0;
+            for (double b : impactParameters) {
+                TrajectoryError e = traceRay(options, rs, b, R, h, maxSteps);
+                totalSteps += e.steps - e.farSteps;
+                row.meanAngle += e.angle / impactParameters.size();
+                row.maxAngle = std::max(row.maxAngle, e.angle);
+                row.nullDrift = std::max(row.nullDrift, e.nullDrift);
+                row.energyDrift = std::max(row.energyDrift, e.energyDrift);
+                row.momentumDrift = std::max(row.momentumDrift, e.momentumDrift);
+            }
+            row.rhsPerRay = double(totalSteps) * Ray::RHSEvaluations(options.integrator) / impactParameters.size();
+            rows.push_back(row);
+        }
+    }
+
+    // Pareto front over (cost, max angle error)
+    for (Row& row : rows) {
+        row.pareto = std::none_of(rows.begin(), rows.end(), [&](const Row& other){
+            return other.rhsPerRay <= row.rhsPerRay && other.maxAngle <= row.maxAngle &&
+                   (other.rhsPerRay < row.rhsPerRay || other.maxAngle < row.maxAngle);
+        });
+    }
+    std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b){ return a.rhsPerRay < b.rhsPerRay; });
+
+    auto label = [](const Row& row){
+        return std::string(Ray::IntegratorName(row.options.integrator)) +
+               (row.options.projectInvariants ? "+proj" : "") + (row.options.regularizeHorizon ? "+reg" : "") +
+               (row.options.farRadius > 0.0 ? "+far" : "");
+    };
+
+    std::printf("%d impact parameters from %.4g to %.4g rs, R = %g rs, rs = %g screen units\n\n",
+                impacts, impactParameters.front() / rs, impactParameters.back() / rs, radiusRs, rs);
+    std::printf("%-16s %9s %12s %12s %12s %12s %12s %12s %s\n", "integrator", "step", "rhs/ray",
+                "mean err", "max err", "null drift", "E drift", "L drift", "pareto");
+    for (const Row& row : rows) {
+        std::printf("%-16s %9.4g %12.0f %12.3e %12.3e %12.3e %12.3e %12.3e %s\n",
+                    label(row).c_str(), row.stepSize, row.rhsPerRay, row.meanAngle,
+                    row.maxAngle, row.nullDrift, row.energyDrift, row.momentumDrift, row.pareto ? "*" : "");
+    }
+
+    if (tolerance > 0.0) {
+        auto best = std::find_if(rows.begin(), rows.end(), [&](const Row& row){ return row.maxAngle <= tolerance; });
+        if (best == rows.end()) std::printf("\nno setting reaches a max error of %g rad\n", tolerance);
+        else std::printf("\ncheapest within %g rad: %s with step %g (%.0f rhs/ray)\n", tolerance,
+                         label(*best).c_str(), best->stepSize, best->rhsPerRay);
+    }
+
+    if (!csvPath.empty()) {
+        std::ofstream csv(csvPath);
+        if (!csv) {
+            std::cerr << "Failed to write " << csvPath << std::endl;
+            return EXIT_FAILURE;
+        }
+        csv << "integrator,step,rhs_per_ray,mean_error,max_error,null_drift,energy_drift,momentum_drift,pareto\n";
+        csv.precision(6);
+        for (const Row& row : rows) {
+            csv << label(row) << "," << row.stepSize << "," << row.rhsPerRay << ","
+                << row.meanAngle << "," << row.maxAngle << "," << row.nullDrift << "," << row.energyDrift << ","
+                << row.momentumDrift << "," << (row.pareto ? 1 : 0) << "\n";
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,389 @@
+// Headless batch simulation: runs the ray simulation with no window or GL
+// context and reports integration throughput. Used for sizing runs and for
+// comparing integrators without the V-Sync cap of the interactive app.
+#include "Simulation.h"
+#include "ImageIO.h"
+#include "LensingTracer.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <string>
+
+static std::string integratorList(){
+    std::string list;
+    for (Integrator integrator : Ray::Integrators()) {
+        if (!list.empty()) list += " | ";
+        list += Ray::IntegratorName(integrator);
+    }
+    return list;
+}
+
+static std::string spacetimeList(){
+    std::string list;
+    for (Spacetime spacetime : Spacetimes()) {
+        if (!list.empty()) list += " | ";
+        list += SpacetimeName(spacetime);
+    }
+    return list;
+}
+
+static std::string samplingList(){
+    std::string list;
+    for (Sampling sampling : Samplings()) {
+        if (!list.empty()) list += "|";
+        list += SamplingName(sampling);
+    }
+    return list;
+}
+
+// PNG if path ends in .png, PPM otherwise; reports failures
+static bool writeImage(const std::string& path, const std::vector<glm::vec3>& pixels, int width, int height){
+    bool png = path.size() >= 4 && path.compare(path.size() - 4, 4, ".png") == 0;
+    if (png ? WritePNG(path, pixels, width, height) : WritePPM(path, pixels, width, height)) return true;
+    std::cerr << "Failed to write " << path << std::endl;
+    return false;
+}
+
+// Rewrites path with the statistics so far
+static bool writeStatistics(const std::string& path, const RetireStatistics& statistics){
+    std::ofstream out(path);
+    statistics.Write(out);
+    if (out) return true;
+    std::cerr << "Failed to write " << path << std::endl;
+    return false;
+}
+
+// path with _NNNN inserted before the extension
+static std::string numbered(const std::string& path, int frame){
+    char suffix[16];
+    std::snprintf(suffix, sizeof(suffix), "_%04d", frame);
+    size_t dot = path.find_last_of('.'), slash = path.find_last_of('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return path + suffix;
+    return path.substr(0, dot) + suffix + path.substr(dot);
+}
+
+static void printUsage(const char* program){
+    std::cout <<
+        "Usage: " << program << " [options]\n"
+        "  --rays N          number of rays (200)\n"
+        "  --step H          affine step per iteration (0.01)\n"
+        "  --steps N         iterations to run (1000)\n"
+        "  --integrator NAME " << integratorList() << " (rk4)\n"
+        "  --project         project (dr, dphi) onto the E, L constraint after each step\n"
+        "  --regularize      horizon-regular right hand side within 3 rs, capture at rs\n"
+        "  --spacetime NAME  " << spacetimeList() << " (schwarzschild)\n"
+        "  --charge Q        Reissner-Nordstrom rq in units of rs, up to 0.5 (0)\n"
+        "  --cosmological L  Schwarzschild-de Sitter Lambda in units of 1/rs^2, below 4/27 (0)\n"
+        "  --spin A          Kerr black hole with a/M = A about the z axis; not with\n"
+        "                    --spacetime, --integrator or --far (0)\n"
+        "  --lenses N        stars lensing in the weak field, Barnes-Hut summed (0)\n"
+        "  --lens-mass X     star mass relative to the black hole (0.001)\n"
+        "  --lens-radius R   radius of the star field, screen units (20)\n"
+        "  --lens-theta T    Barnes-Hut opening angle; 0 sums every star (0.5)\n"
+        "  --particles N     infalling massive particles on timelike geodesics (0)\n"
+        "  --drag D          particle angular momentum loss rate, per unit proper time (0.002)\n"
+        "  --recycle R       particles respawn inside R rs: 1 = horizon, 3 = ISCO (1)\n"
+        "  --far R           analytic weak-field steps beyond R rs (off when omitted)\n"
+        "  --pixels PX       screen-space stepping: no step moves a ray more than PX pixels\n"
+        "                    on an 800x600, 45 degree view (fixed steps when omitted)\n"
+        "  --multirate RAD   per-ray clocks: each ray steps when its own step runs out,\n"
+        "                    bending at most RAD radians per step (off when omitted)\n"
+        "  --camera R        camera distance for --pixels, screen units (5)\n"
+        "  --threads N       worker threads, 0 = all cores (0)\n"
+        "  --trail N         trail points kept per ray, 0 = none (1000)\n"
+        "  --trail-spacing L affine parameter between trail points, sampled from the\n"
+        "                    dense output; 0 = one point per step (0)\n"
+        "  --impact          emit a beam by impact parameter, peaked at the critical b\n"
+        "  --peak-fraction F share of --impact rays drawn from the peak (0.75)\n"
+        "  --peak-width W    half width of the peak, units of rs (0.05)\n"
+        "  --max-impact B    beam radius, units of rs (4)\n"
+        "  --density MODE    splat rays into a screen|volume density grid, no trails kept\n"
+        "  --density-out F   write the tone-mapped density to F (.png or .ppm)\n"
+        "  --voxels N        volume grid resolution per side (128)\n"
+        "  --detector X      detector plane at x = X facing the rays, records crossings\n"
+        "  --detector-size S detector half width, screen units (3)\n"
+        "  --detector-pixels N  detector resolution per side (256)\n"
+        "  --detector-out F  write the detector image to F (.png or .ppm)\n"
+        "  --detector-every N  also write it every N steps, numbered F_0001 ...\n"
+        "  --stats F         stream capture, deflection and escape-time statistics of\n"
+        "                    retiring rays to F as JSON (use --trail 0 for huge runs)\n"
+        "  --stats-every N   also rewrite F every N steps\n"
+        "  --sampling NAME   " << samplingList() << ": how rays cover the emitter (random)\n"
+        "  --seed N          seed for the rays, lenses and particles (1)\n";
+}
+
+int main(int argc, char** argv){
+    int numRays = 200, steps = 1000;
+    long long trailLength = 1000;
+    uint64_t seed = 1;
+    float cameraRadius = 5.0f;
+    int lensCount = 0;
+    double lensMass = 0.001, lensRadius = 20.0;
+    long long particleCount = 0;
+    std::string densityOut, detectorOut, statsOut;
+    int detectorEvery = 0, statsEvery = 0;
+
+    // Same black hole as the interactive app
+    Simulation simulation(BlackHole(glm::vec3(0.0f), 8.54e36));
+    simulation.threads = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        }
+        if (arg == "--impact") {
+            simulation.impact.enabled = true;
+            continue;
+        }
+        if (arg == "--project") {
+            simulation.options.projectInvariants = true;
+            continue;
+        }
+        if (arg == "--regularize") {
+            simulation.options.regularizeHorizon = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return EXIT_FAILURE;
+        }
+        const char* value = argv[++i];
+
+        if (arg == "--rays") numRays = std::atoi(value);
+        else if (arg == "--step") simulation.stepSize = std::strtod(value, nullptr);
+        else if (arg == "--steps") steps = std::atoi(value);
+        else if (arg == "--threads") simulation.threads = static_cast<unsigned int>(std::atoi(value));
+        else if (arg == "--trail") trailLength = std::atoll(value);
+        else if (arg == "--trail-spacing") simulation.options.trailSpacing = std::strtod(value, nullptr);
+        else if (arg == "--spacetime") {
+            if (!ParseSpacetime(value, simulation.options.spacetime)) {
+                std::cerr << "Unknown spacetime " << value << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (arg == "--charge") simulation.options.charge = std::strtod(value, nullptr);
+        else if (arg == "--cosmological") simulation.options.cosmologicalConstant = std::strtod(value, nullptr);
+        else if (arg == "--spin") simulation.blackhole.spin = std::strtod(value, nullptr);
+        else if (arg == "--lenses") lensCount = std::atoi(value);
+        else if (arg == "--lens-mass") lensMass = std::strtod(value, nullptr);
+        else if (arg == "--lens-radius") lensRadius = std::strtod(value, nullptr);
+        else if (arg == "--lens-theta") simulation.lenses.theta = std::strtod(value, nullptr);
+        else if (arg == "--peak-fraction") simulation.impact.peakFraction = std::strtod(value, nullptr);
+        else if (arg == "--peak-width") simulation.impact.peakWidth = std::strtod(value, nullptr);
+        else if (arg == "--max-impact") simulation.impact.maxImpact = std::strtod(value, nullptr);
+        else if (arg == "--density") {
+            simulation.density.enabled = true;
+            if (std::string(value) == "screen") simulation.density.mode = DensityMode::Screen;
+            else if (std::string(value) == "volume") simulation.density.mode = DensityMode::Volume;
+            else {
+                std::cerr << "Unknown density mode " << value << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (arg == "--density-out") densityOut = value;
+        else if (arg == "--voxels") simulation.density.resolution = std::atoi(value);
+        else if (arg == "--detector") {
+            simulation.detector.enabled = true;
+            simulation.detector.center = glm::vec3(std::strtof(value, nullptr), 0.0f, 0.0f);
+        }
+        else if (arg == "--detector-size") simulation.detector.halfWidth = simulation.detector.halfHeight = std::strtof(value, nullptr);
+        else if (arg == "--detector-pixels") simulation.detector.width = simulation.detector.height = std::atoi(value);
+        else if (arg == "--detector-out") detectorOut = value;
+        else if (arg == "--detector-every") detectorEvery = std::atoi(value);
+        else if (arg == "--stats") {
+            statsOut = value;
+            simulation.statistics.enabled = true;
+        }
+        else if (arg == "--stats-every") statsEvery = std::atoi(value);
+        else if (arg == "--particles") particleCount = std::atoll(value);
+        else if (arg == "--drag") simulation.particles.drag = std::strtod(value, nullptr);
+        else if (arg == "--recycle") simulation.particles.recycleRadius = std::strtod(value, nullptr);
+        else if (arg == "--far") simulation.options.farRadius = std::strtod(value, nullptr);
+        else if (arg == "--pixels") {
+            simulation.screen.enabled = true;
+            simulation.screen.pixels = std::strtof(value, nullptr);
+        }
+        else if (arg == "--multirate") {
+            simulation.multirate.enabled = true;
+            simulation.multirate.turnAngle = std::strtod(value, nullptr);
+        }
+        else if (arg == "--camera") cameraRadius = std::strtof(value, nullptr);
+        else if (arg == "--seed") seed = std::strtoull(value, nullptr, 10);
+        else if (arg == "--sampling") {
+            if (!ParseSampling(value, simulation.sampling)) {
+                std::cerr << "Unknown sampling " << value << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (arg == "--integrator") {
+            if (!Ray::ParseIntegrator(value, simulation.options.integrator)) {
+                std::cerr << "Unknown integrator " << value << " (expected " << integratorList() << ")." << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (numRays <= 0 || steps <= 0 || trailLength < 0 || simulation.stepSize <= 0.0) {
+        std::cerr << "Ray count, step count and step size must be positive, trail length not negative." << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (simulation.screen.enabled && (simulation.screen.pixels <= 0.0f || cameraRadius <= 0.0f)) {
+        std::cerr << "--pixels and --camera must be positive." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const StepOptions& options = simulation.options;
+    if (options.charge < 0.0 || options.charge > 0.5 || options.cosmologicalConstant < 0.0 ||
+        options.cosmologicalConstant >= 4.0 / 27.0 || std::abs(simulation.blackhole.spin) >= 1.0) {
+        std::cerr << "--charge must be in [0, 0.5], --cosmological in [0, 4/27) and --spin in (-1, 1)." << std::endl;
+        return EXIT_FAILURE;
+    }
+    // Kerr rays take their own first-order integrator, which has no other
+    // spacetimes and no weak-field far steps: refuse rather than ignore them
+    if (simulation.blackhole.spin != 0.0 && (options.spacetime != Spacetime::Schwarzschild ||
+        options.integrator != Integrator::RK4 || options.farRadius > 0.0)) {
+        std::cerr << "--spin cannot be combined with --spacetime, --integrator or --far." << std::endl;
+        return EXIT_FAILURE;
+    }
+    if ((simulation.multirate.enabled && simulation.multirate.turnAngle <= 0.0) || simulation.options.farRadius < 0.0) {
+        std::cerr << "--multirate and --far must be positive." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (lensCount < 0 || lensMass <= 0.0 || lensRadius <= 2.0 || simulation.lenses.theta < 0.0) {
+        std::cerr << "--lenses must not be negative, --lens-mass positive, --lens-radius above 2 and --lens-theta not negative." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (particleCount < 0 || simulation.particles.drag < 0.0 || simulation.particles.recycleRadius <= 0.0) {
+        std::cerr << "--particles and --drag must not be negative, --recycle must be positive." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (simulation.density.resolution <= 0) {
+        std::cerr << "--voxels must be positive." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (simulation.detector.halfWidth <= 0.0f || simulation.detector.width <= 0 || detectorEvery < 0 || statsEvery < 0) {
+        std::cerr << "--detector-size and --detector-pixels must be positive, --detector-every and --stats-every not negative." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const ImpactEmitter& impact = simulation.impact;
+    if (impact.peakFraction < 0.0 || impact.peakFraction >= 1.0 || impact.peakWidth <= 0.0 || impact.maxImpact <= 0.0) {
+        std::cerr << "--peak-fraction must be in [0, 1), --peak-width and --max-impact positive." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // The interactive app's default view
+    float fovY = glm::radians(45.0f), aspect = 800.0f / 600.0f;
+    LensingCamera camera = LensingCamera::Orbit(cameraRadius, 0.0f, 0.0f, fovY, aspect, 800, 600);
+    simulation.SetView(camera.view, glm::perspective(fovY, aspect, 0.1f, 50.0f), camera.height);
+
+    simulation.seed = seed;
+    simulation.InitializeRays(numRays);
+    if (lensCount > 0) simulation.InitializeLenses(lensCount, lensRadius, lensMass);
+    simulation.particles.seed = seed;
+    simulation.particles.threads = simulation.threads;
+    if (particleCount > 0) simulation.particles.Initialize(static_cast<size_t>(particleCount), simulation.blackhole.r_s);
+    // The density grid replaces the trails
+    if (simulation.density.enabled) trailLength = 0;
+    for (auto& ray : simulation.rays) ray.maxTrailLength = static_cast<size_t>(trailLength);
+
+    // Incremental exports run the steps in chunks; Run carries the clock
+    // over, so the result is the same as one long run
+    if (!simulation.detector.enabled || detectorOut.empty()) detectorEvery = 0;
+    if (statsOut.empty()) statsEvery = 0;
+    int chunk = std::gcd(detectorEvery, statsEvery);
+    if (chunk <= 0) chunk = steps;
+    // Only the integration is timed, not the snapshot writes between chunks
+    double seconds = 0.0;
+    long long integrated = 0;
+    for (int done = 0; done < steps;) {
+        auto start = std::chrono::steady_clock::now();
+        integrated += simulation.Run(std::min(chunk, steps - done));
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        done += std::min(chunk, steps - done);
+        if (detectorEvery > 0 && done % detectorEvery == 0 &&
+            !writeImage(numbered(detectorOut, done / detectorEvery), simulation.detector.Normalized(),
+                        simulation.detector.width, simulation.detector.height)) {
+            return EXIT_FAILURE;
+        }
+        if (statsEvery > 0 && done % statsEvery == 0 && !writeStatistics(statsOut, simulation.statistics)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    RetireStats retired = simulation.Census();
+    InvariantStats invariants = simulation.Invariants();
+    std::cout << numRays << " rays x " << steps << " steps of " << simulation.stepSize << "\n"
+              << "ray steps:  " << integrated << " integrated in " << seconds << " s\n"
+              << "throughput: " << (seconds > 0.0 ? integrated / seconds : 0.0) << " ray-steps/s\n"
+              << "retired:    " << retired.captured << " captured, " << retired.escaped << " escaped, "
+              << retired.active << " active\n"
+              << "invariants: null residual " << invariants.meanNullResidual << " mean, " << invariants.maxNullResidual
+              << " max; E drift " << invariants.meanEnergyDrift << " mean, " << invariants.maxEnergyDrift
+              << " max; L drift " << invariants.meanMomentumDrift << " mean, " << invariants.maxMomentumDrift
+              << " max (" << invariants.rays << " active rays)" << std::endl;
+    if (impact.enabled) {
+        // Only rays with b < b_c are captured, so the weighted captured share
+        // of the beam gives b_c back: an end-to-end check of the weights
+        double total = retired.capturedWeight + retired.escapedWeight + retired.activeWeight;
+        std::cout << "impact:     weights sum to " << total << " over " << numRays << " rays; capture radius "
+                  << impact.maxImpact * std::sqrt(retired.capturedWeight / numRays) << " rs (3 sqrt(3)/2 = "
+                  << 1.5 * std::sqrt(3.0) << ")" << std::endl;
+    }
+    if (simulation.density.enabled) {
+        const DensityGrid& density = simulation.density;
+        double total = 0.0;
+        for (float d : density.Cells()) total += d;
+        std::cout << "density:    " << density.Cells().size() << " cells x " << density.Tiles() + 1
+                  << " buffers (" << (density.Tiles() + 1) * density.Cells().size() * sizeof(float) / 1048576.0
+                  << " MB), " << total << " ray-frames binned" << std::endl;
+        if (!densityOut.empty()) {
+            int w, h;
+            std::vector<glm::vec3> pixels = density.ToneMap(w, h);
+            if (!writeImage(densityOut, pixels, w, h)) return EXIT_FAILURE;
+        }
+    }
+    if (simulation.statistics.enabled) {
+        const RetireStatistics& statistics = simulation.statistics;
+        double retiredWeight = statistics.captured.weight + statistics.escaped.weight;
+        std::cout << "statistics: capture fraction " << (retiredWeight > 0.0 ? statistics.captured.weight / retiredWeight : 0.0)
+                  << ", deflection median " << statistics.deflectionQuantiles.Quantile(0.5)
+                  << " rad, escape time median " << statistics.escapeTime.Quantile(0.5) << std::endl;
+        if (!writeStatistics(statsOut, statistics)) return EXIT_FAILURE;
+    }
+    if (simulation.detector.enabled) {
+        const DetectorScreen& detector = simulation.detector;
+        std::cout << "detector:   " << detector.Hits() << " crossings on " << detector.width << "x" << detector.height
+                  << " pixels at x = " << detector.center.x << std::endl;
+        if (!detectorOut.empty() && !writeImage(detectorOut, detector.Normalized(), detector.width, detector.height)) {
+            return EXIT_FAILURE;
+        }
+    }
+    if (!simulation.lenses.Empty()) {
+        std::cout << "lenses:     " << simulation.lenses.Lenses().size() << " in " << simulation.lenses.Nodes()
+                  << " tree nodes, built " << simulation.lenses.Builds() << " time(s)" << std::endl;
+    }
+    if (!simulation.particles.Empty()) {
+        const ParticleSwarm& particles = simulation.particles;
+        std::cout << "particles:  " << particles.Size() << ", " << particles.Substeps() << " substeps ("
+                  << (seconds > 0.0 ? particles.Substeps() / seconds : 0.0) << "/s, timed with the rays); "
+                  << particles.Captured() << " recycled at " << particles.recycleRadius << " rs, "
+                  << particles.Escaped() << " escaped" << std::endl;
+    }
+    return 0;
+}
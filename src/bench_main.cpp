@@ -0,0 +1,357 @@
+// Microbenchmarks for the hot paths: the geodesic right hand side, one RK4
+// step, Ray::Step (integration plus trail update) across trail lengths, the
+// point lens field by Barnes-Hut and by direct summation, one frame of the
+// particle swarm per particle, and,
+// when built with SAGITTARIUS_HEADLESS, black hole mesh setup and ray draw
+// submission on a surfaceless (software or GPU) GL context.
+// Results are written as JSON so runs can be diffed across commits.
+#include "LensTree.h"
+#include "ParticleSwarm.h"
+#include "Ray.h"
+
+#ifdef SAGITTARIUS_HEADLESS
+#include "view/gl_renderer.h"
+#include "view/headless_context.h"
+#include "view/shader.h"
+#endif
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Set by CMake from the configuration; builds outside CMake say so
+#ifndef SAGITTARIUS_BUILD_TYPE
+#define SAGITTARIUS_BUILD_TYPE "unknown"
+#endif
+
+struct BenchResult{
+    std::string name;
+    int rays = 0;               // 0 when the benchmark has no ray count
+    int trail = 0;              // 0 when the benchmark has no trail length
+    long long iterations = 0;   // calls of the measured body per repetition
+    long long opsPerIteration = 1;
+    double nsPerOp = 0.0;       // median over repetitions
+    double nsPerOpMin = 0.0;
+};
+
+struct BenchOptions{
+    std::vector<int> rayCounts = { 100, 1000, 10000 };
+    std::vector<int> trailLengths = { 10, 100, 1000 };
+    double minSeconds = 0.2;    // per repetition
+    int repetitions = 5;
+    std::string filter;
+    std::string out;
+};
+
+// Keeps results alive so the optimizer cannot drop the measured work
+static volatile double sink;
+
+// Runs body (which performs opsPerIteration operations) often enough to fill
+// minSeconds, repeats that, and reports the median time per operation.
+static BenchResult measure(const BenchOptions& options, const std::string& name, int rays, int trail,
+                           long long opsPerIteration, const std::function<void()>& body){
+    using clock = std::chrono::steady_clock;
+    BenchResult result;
+    result.name = name;
+    result.rays = rays;
+    result.trail = trail;
+    result.opsPerIteration = opsPerIteration;
+
+    // Grow the iteration count until one repetition takes long enough
+    long long iterations = 1;
+    for (;;) {
+        auto start = clock::now();
+        for (long long i = 0; i < iterations; ++i) body();
+        double seconds = std::chrono::duration<double>(clock::now() - start).count();
+        if (seconds >= options.minSeconds || iterations >= (1LL << 40)) break;
+        double scale = seconds > 0.0 ? options.minSeconds / seconds : 10.0;
+        iterations = static_cast<long long>(iterations * std::clamp(scale * 1.2, 1.5, 10.0)) + 1;
+    }
+
+    std::vector<double> samples;
+    for (int rep = 0; rep < options.repetitions; ++rep) {
+        auto start = clock::now();
+        for (long long i = 0; i < iterations; ++i) body();
+        double seconds = std::chrono::duration<double>(clock::now() - start).count();
+        samples.push_back(seconds * 1e9 / double(iterations * opsPerIteration));
+    }
+    std::sort(samples.begin(), samples.end());
+
+    result.iterations = iterations;
+    result.nsPerOp = samples[samples.size() / 2];
+    result.nsPerOpMin = samples.front();
+    std::cerr << name;
+    if (rays) std::cerr << " rays=" << rays;
+    if (trail) std::cerr << " trail=" << trail;
+    std::cerr << ": " << result.nsPerOp << " ns/op" << std::endl;
+    return result;
+}
+
+// Rays on wide orbits around the hole: never captured, so every call of
+// Ray::Step does the full integration and trail update
+static std::vector<Ray> makeRays(int count, int trailLength){
+    std::vector<Ray> rays;
+    rays.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        float angle = 6.2831853f * float(i) / float(count);
+        float radius = 8.0f + 4.0f * float(i % 7) / 7.0f;
+        glm::vec3 pos(radius * std::cos(angle), radius * std::sin(angle), 0.3f * float(i % 5) - 0.6f);
+        glm::vec3 dir = glm::normalize(glm::vec3(-std::sin(angle), std::cos(angle), 0.1f));
+        Ray ray(pos, dir);
+        ray.maxTrailLength = static_cast<size_t>(trailLength);
+        ray.trail.assign(static_cast<size_t>(trailLength), glm::vec4(pos, 1.0f));
+        rays.push_back(std::move(ray));
+    }
+    return rays;
+}
+
+// States spread over the range the simulation sees, from the photon sphere out
+static std::vector<std::array<double, 4>> makeStates(double rs){
+    std::vector<std::array<double, 4>> states;
+    for (int i = 0; i < 256; ++i) {
+        double r = rs * (1.6 + 30.0 * i / 256.0);
+        states.push_back({ r, 0.01 * i, std::cos(0.1 * i), std::sin(0.1 * i) / r });
+    }
+    return states;
+}
+
+static bool selected(const BenchOptions& options, const std::string& name){
+    return options.filter.empty() || name.find(options.filter) != std::string::npos;
+}
+
+static void runCpuBenchmarks(const BenchOptions& options, std::vector<BenchResult>& results){
+    const double rs = Ray::ScreenSchwarzschildRadius(1.0);
+    auto states = makeStates(rs);
+
+    if (selected(options, "geodesicRHS")) {
+        results.push_back(measure(options, "geodesicRHS", 0, 0, static_cast<long long>(states.size()), [&]{
+            double rhs[4], acc = 0.0;
+            for (const auto& y : states) {
+                Ray::geodesicRHS(y.data(), 1.0, rhs, rs);
+                acc += rhs[2];
+            }
+            sink = acc;
+        }));
+    }
+
+    if (selected(options, "rk4Step")) {
+        results.push_back(measure(options, "rk4Step", 0, 0, static_cast<long long>(states.size()), [&]{
+            double acc = 0.0;
+            for (const auto& s : states) {
+                double y[4] = { s[0], s[1], s[2], s[3] };
+                Ray::rk4Step(y, 1.0, 0.01, rs);
+                acc += y[0];
+            }
+            sink = acc;
+        }));
+    }
+
+    if (selected(options, "Ray::Step")) {
+        for (int trail : options.trailLengths) {
+            for (int count : options.rayCounts) {
+                std::vector<Ray> rays = makeRays(count, trail);
+                results.push_back(measure(options, "Ray::Step", count, trail, count, [&]{
+                    for (auto& ray : rays) ray.Step(0.01, 1.0);
+                }));
+            }
+        }
+    }
+
+    // Single threaded, so the figure is per core. The rays column holds the
+    // particle count, 100x each ray count; each op is one particle frame.
+    if (selected(options, "ParticleSwarm::Run")) {
+        for (int count : options.rayCounts) {
+            ParticleSwarm swarm;
+            swarm.threads = 1;
+            swarm.Initialize(static_cast<size_t>(count) * 100, 8.54e36);
+            results.push_back(measure(options, "ParticleSwarm::Run", count * 100, 0, static_cast<long long>(swarm.Size()), [&]{
+                swarm.Run(1);
+            }));
+        }
+    }
+
+    // The rays column holds the lens count; each op is one field query
+    if (selected(options, "LensTree::Field")) {
+        for (int count : options.rayCounts) {
+            LensTree tree;
+            std::vector<PointLens> lenses;
+            for (int i = 0; i < count; ++i) {
+                double u = (i + 0.5) / count, phi = 2.39996323 * i;
+                double z = 1.0 - 2.0 * u, rho = std::sqrt(1.0 - z * z), radius = 20.0 * std::cbrt(u);
+                lenses.push_back({ radius * glm::dvec3(rho * std::cos(phi), rho * std::sin(phi), z), 1e-3 * rs });
+            }
+            tree.SetLenses(std::move(lenses));
+            tree.Update();
+            auto queries = makeRays(256, 1);
+            results.push_back(measure(options, "LensTree::Field", count, 0, static_cast<long long>(queries.size()), [&]{
+                double acc = 0.0;
+                for (const auto& ray : queries) acc += tree.Field(ray.StatePosition()).x;
+                sink = acc;
+            }));
+            results.push_back(measure(options, "LensTree::FieldDirect", count, 0, static_cast<long long>(queries.size()), [&]{
+                double acc = 0.0;
+                for (const auto& ray : queries) acc += tree.FieldDirect(ray.StatePosition()).x;
+                sink = acc;
+            }));
+        }
+    }
+}
+
+#ifdef SAGITTARIUS_HEADLESS
+static void runGlBenchmarks(const BenchOptions& options, std::vector<BenchResult>& results){
+    bool wantSetup = selected(options, "GLRenderer::Setup");
+    bool wantDraw = selected(options, "GLRenderer::DrawRays");
+    if (!wantSetup && !wantDraw) return;
+
+    HeadlessContext context;
+    if (!context.Create(800, 600)) {
+        std::cerr << "Skipping GL benchmarks: no surfaceless context." << std::endl;
+        return;
+    }
+    GLuint shader = make_shader("../src/shaders/vertex.txt", "../src/shaders/fragment.txt");
+    if (!shader) {
+        std::cerr << "Skipping GL benchmarks: failed to create shader program." << std::endl;
+        context.Destroy();
+        return;
+    }
+
+    // Mesh setup: sphere generation and upload (plus the small ray buffers)
+    if (wantSetup) {
+        results.push_back(measure(options, "GLRenderer::Setup", 0, 0, 1, [&]{
+            GLRenderer renderer(shader);
+            glFinish();
+        }));
+    }
+
+    // Draw submission, including glFinish so deferred driver work is counted
+    if (wantDraw) {
+        GLRenderer renderer(shader);
+        for (int trail : options.trailLengths) {
+            for (int count : options.rayCounts) {
+                std::vector<Ray> rays = makeRays(count, trail);
+                results.push_back(measure(options, "GLRenderer::DrawRays", count, trail, count, [&]{
+                    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                    renderer.DrawRays(rays);
+                    glFinish();
+                }));
+            }
+        }
+    }
+
+    glDeleteProgram(shader);
+    context.Destroy();
+}
+#endif
+
+static std::string toJson(const std::vector<BenchResult>& results, const BenchOptions& options){
+    std::ostringstream json;
+    json << "{\n  \"build_type\": \"" << SAGITTARIUS_BUILD_TYPE << "\""
+         << ",\n  \"min_seconds\": " << options.minSeconds
+         << ",\n  \"repetitions\": " << options.repetitions
+#ifdef SAGITTARIUS_HEADLESS
+         << ",\n  \"gl\": true"
+#else
+         << ",\n  \"gl\": false"
+#endif
+         << ",\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        json << (i ? "," : "") << "\n    { \"name\": \"" << r.name << "\""
+             << ", \"rays\": " << r.rays
+             << ", \"trail\": " << r.trail
+             << ", \"iterations\": " << r.iterations
+             << ", \"ops_per_iteration\": " << r.opsPerIteration
+             << ", \"ns_per_op\": " << r.nsPerOp
+             << ", \"ns_per_op_min\": " << r.nsPerOpMin
+             << ", \"ops_per_second\": " << (r.nsPerOp > 0.0 ? 1e9 / r.nsPerOp : 0.0) << " }";
+    }
+    json << "\n  ]\n}\n";
+    return json.str();
+}
+
+static bool parseList(const char* value, std::vector<int>& list){
+    list.clear();
+    std::stringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        int n = std::atoi(item.c_str());
+        if (n <= 0) return false;
+        list.push_back(n);
+    }
+    return !list.empty();
+}
+
+static void printUsage(const char* program){
+    std::cout <<
+        "Usage: " << program << " [options]\n"
+        "  --rays LIST       ray counts to sweep, comma separated (100,1000,10000)\n"
+        "  --trails LIST     trail lengths to sweep, comma separated (10,100,1000)\n"
+        "  --min-time S      minimum seconds per repetition (0.2)\n"
+        "  --repetitions N   repetitions, the median is reported (5)\n"
+        "  --filter TEXT     only run benchmarks whose name contains TEXT\n"
+        "  --out FILE        write the JSON to FILE instead of stdout\n";
+}
+
+int main(int argc, char** argv){
+    BenchOptions options;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return EXIT_FAILURE;
+        }
+        const char* value = argv[++i];
+
+        if (arg == "--rays" || arg == "--trails") {
+            if (!parseList(value, arg == "--rays" ? options.rayCounts : options.trailLengths)) {
+                std::cerr << "Expected a comma separated list of positive integers for " << arg << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (arg == "--min-time") options.minSeconds = std::strtod(value, nullptr);
+        else if (arg == "--repetitions") options.repetitions = std::atoi(value);
+        else if (arg == "--filter") options.filter = value;
+        else if (arg == "--out") options.out = value;
+        else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (options.minSeconds <= 0.0 || options.repetitions <= 0) {
+        std::cerr << "Minimum time and repetitions must be positive." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<BenchResult> results;
+    runCpuBenchmarks(options, results);
+#ifdef SAGITTARIUS_HEADLESS
+    runGlBenchmarks(options, results);
+#endif
+
+    std::string json = toJson(results, options);
+    if (options.out.empty()) {
+        std::cout << json;
+    } else {
+        std::ofstream file(options.out);
+        if (!file) {
+            std::cerr << "Failed to write " << options.out << std::endl;
+            return EXIT_FAILURE;
+        }
+        file << json;
+    }
+    return 0;
+}
@@ -4,16 +4,5 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
-// Include GLM for mathematical operations and transformations
-#include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
-#include <random>
-
-// Include standard libraries for input/output and data structures
-#include <iostream>
-#include <vector>
-#include <unordered_map>
-#include <fstream>
-#include <sstream>
-#include <string>
\ No newline at end of file
+// GLM and the standard library, shared with the GL-free simulation core
+#include "core_config.h"
\ No newline at end of file
@@ -1,61 +1,166 @@
 #include "app.h"
 #include "../view/shader.h" 
+#include "../view/gl_renderer.h"
+#include "../Simulation.h"
 #include "../BlackHole.h"
 #include "../Ray.h"
+#include "../ImageIO.h"
+#include <chrono>
 
 // Constructor for the App class
-// Sets up GLFW for window and context management
-App::App() {
-    set_up_glfw();
+// Sets up GLFW (or the surfaceless EGL backend) for context management
+App::App(Backend backend, HeadlessSettings headless) : backend(backend), headless(headless) {
+    if (backend == Backend::Headless) {
+        set_up_headless();
+    } else {
+        set_up_glfw();
+    }
 }
 
 // Destructor for the App class
 // Cleans up resources and terminates GLFW
 App::~App() {
     glDeleteProgram(shader); // Delete the shader program
-    glfwTerminate(); // Terminate GLFW
+    if (backend == Backend::Headless) {
+#ifdef SAGITTARIUS_HEADLESS
+        headlessContext.Destroy();
+#endif
+    } else {
+#ifndef SAGITTARIUS_NO_WINDOW
+        glfwTerminate(); // Terminate GLFW
+#endif
+    }
 }
 
 // Main loop to run the application
 void App::run(BlackHole& blackhole) {
 
-	lastTime = glfwGetTime(); // Initialize the last frame time
+	lastTime = get_time(); // Initialize the last frame time
 	numFrames = 0; // Initialize the frame counter
 	frameTime = 16.0f; // Set the initial frame time
 
-	std::vector<Ray> rays = InitializeRays(200);
+	Simulation simulation(blackhole);
+	simulation.seed = seed;
+	simulation.impact.enabled = impactEmission;
+	simulation.InitializeRays(rayCount);
+	if (densityView) {
+		simulation.density.enabled = true;
+		simulation.density.width = width;
+		simulation.density.height = height;
+		simulation.density.fade = 0.97f; // about a second of afterglow, like the trails
+		simulation.threads = 0;
+		for (auto& ray : simulation.rays) ray.maxTrailLength = 0;
+	}
+	if (pixelTolerance > 0.0f) {
+		simulation.screen.enabled = true;
+		simulation.screen.pixels = pixelTolerance;
+		// Steps get longer than a frame's worth of λ: keep one trail point
+		// per frame from the dense output so trails look the same
+		simulation.options.trailSpacing = simulation.stepSize;
+	}
+
+	if (particleCount > 0) {
+		simulation.particles.seed = seed;
+		simulation.particles.Initialize(particleCount, blackhole.r_s);
+	}
 
-    while (!glfwWindowShouldClose(window)) {
+	GLRenderer renderer(shader);
+
+	// Traced at half of the initial window resolution and upscaled
+	LensedBackground background(400, 300, Ray::ScreenSchwarzschildRadius(blackhole.r_s));
+
+    while (keep_running()) {
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // Clear the screen
 
 		// Update camera view uniform from orbit camera state
 		updateViewUniform();
 
-		blackhole.Draw(shader);
-
-		for (auto& ray : rays){
-			ray.Step(0.01f, blackhole.r_s);
+		if (showLensedBackground) {
+			background.Update(lensingCamera(background.width, background.height), projection);
+			background.Draw();
 		}
 
-		Ray::Draw(rays, shader);
+		if (densityView) {
+			// The grid follows the window; a new size starts it afresh
+			simulation.density.width = width;
+			simulation.density.height = height;
+		}
+		simulation.SetView(view, projection, height);
+		simulation.Step();
+		simulation.Draw(renderer);
 
-		glfwSwapBuffers(window); // Swap the front and back buffers
-		glfwPollEvents(); 
+		present_frame(); // Swap buffers, or finish the offscreen frame
 
 		handle_frame_timing(); // Handle frame timing and update the window title
 	}
+
+	if (backend == Backend::Headless && !headless.screenshot.empty()) {
+#ifdef SAGITTARIUS_HEADLESS
+		std::vector<glm::vec3> pixels;
+		headlessContext.ReadPixels(pixels);
+		if (!WritePPM(headless.screenshot, pixels, width, height)) {
+			std::cerr << "Failed to write " << headless.screenshot << std::endl;
+		}
+#endif
+	}
+}
+
+bool App::keep_running() {
+	if (backend == Backend::Headless) return framesRendered < headless.frames;
+#ifndef SAGITTARIUS_NO_WINDOW
+	return !glfwWindowShouldClose(window);
+#else
+	return false;
+#endif
+}
+
+void App::present_frame() {
+	if (backend == Backend::Headless) {
+		glFinish(); // No swap chain: wait for the frame so timings are honest
+		++framesRendered;
+		return;
+	}
+#ifndef SAGITTARIUS_NO_WINDOW
+	glfwSwapBuffers(window); // Swap the front and back buffers
+	glfwPollEvents(); 
+#endif
+}
+
+double App::get_time() {
+#ifndef SAGITTARIUS_NO_WINDOW
+	if (backend != Backend::Headless) return glfwGetTime();
+#endif
+	// GLFW is never initialized in headless mode
+	auto now = std::chrono::steady_clock::now().time_since_epoch();
+	return std::chrono::duration<double>(now).count();
+}
+
+// Function to create a surfaceless EGL context rendering into a framebuffer object
+void App::set_up_headless() {
+#ifdef SAGITTARIUS_HEADLESS
+	if (!headlessContext.Create(width, height)) {
+		std::cerr << "Failed to create headless OpenGL context." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+#else
+	std::cerr << "Headless rendering is not available: rebuild with -DSAGITTARIUS_HEADLESS=ON." << std::endl;
+	exit(EXIT_FAILURE);
+#endif
 }
 
 // Function to set up GLFW and create a window
 void App::set_up_glfw() {
-
+#ifdef SAGITTARIUS_NO_WINDOW
+	std::cerr << "Windowed rendering is not available: GLFW was not found at build time, use --headless." << std::endl;
+	exit(EXIT_FAILURE);
+#else
     glfwInit(); // Initialize GLFW
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3); 
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE); // Use core profile
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE); // Ensure compatibility
 	
-	window = glfwCreateWindow(800, 600, "Sagittarius A*", NULL, NULL); // Create a window
+	window = glfwCreateWindow(width, height, "Sagittarius A*", NULL, NULL); // Create a window
     if (!window) {
         std::cerr << "Failed to create GLFW window." << std::endl;
         glfwTerminate();
@@ -73,12 +178,14 @@ void App::set_up_glfw() {
 	glfwSetCursorPosCallback(window, cursorPosCallback);
 	glfwSetMouseButtonCallback(window, mouseButtonCallback);
 	glfwSetScrollCallback(window, scrollCallback);
+	glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
 
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {  // Checks if GLAD was able to load al OpenGL function pointers. 
 		std::cerr << "Couldn't load OpenGL." << std::endl;
 		glfwTerminate();
         exit(EXIT_FAILURE);
 	}
+#endif
 }
 
 // Function to set up OpenGL settings and load shaders
@@ -87,8 +194,10 @@ void App::set_up_opengl() {
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f); 
 
 	// Set the rendering region to the actual screen size
-	int w,h;
-	glfwGetFramebufferSize(window, &w, &h); 
+	int w = width, h = height;
+#ifndef SAGITTARIUS_NO_WINDOW
+	if (window) glfwGetFramebufferSize(window, &w, &h); 
+#endif
 	glViewport(0,0,w,h); // Resolution
 
 	glEnable(GL_DEPTH_TEST); // Ensures objects closer to the camera hide objects behind them 
@@ -102,7 +211,9 @@ void App::set_up_opengl() {
 		"../src/shaders/fragment.txt"); // Load and compile shaders
     if (!shader) {
         std::cerr << "Failed to create shader program." << std::endl;
-        glfwTerminate();
+#ifndef SAGITTARIUS_NO_WINDOW
+        if (window) glfwTerminate();
+#endif
         exit(EXIT_FAILURE);
     }
     
@@ -113,8 +224,7 @@ void App::set_up_opengl() {
     if (projLocation == -1) {
         std::cerr << "Failed to find 'projection' uniform location." << std::endl;
     }
-	glm::mat4 projection = glm::perspective(
-		glm::radians(45.0f), 640.0f / 480.0f, 0.1f, 50.0f); // Create a perspective projection matrix
+	projection = glm::perspective(fovY, aspect, zNear, zFar); // Create a perspective projection matrix
 	glUniformMatrix4fv(projLocation, 1, GL_FALSE, glm::value_ptr(projection)); 
 
 	// Set initial view and model matrices (view will be updated each frame)
@@ -133,7 +243,8 @@ void App::set_up_opengl() {
 	glUniformMatrix4fv(modelLocation, 1, GL_FALSE, glm::value_ptr(model));
 }
 
-// Static callbacks
+// Static callbacks, registered on the GLFW window only
+#ifndef SAGITTARIUS_NO_WINDOW
 void App::cursorPosCallback(GLFWwindow* window, double xpos, double ypos) {
 	App* app = static_cast<App*>(glfwGetWindowUserPointer(window));
 	if (!app) return;
@@ -182,14 +293,27 @@ void App::scrollCallback(GLFWwindow* window, double xoffset, double yoffset) {
 	if (app->camRadius > 50.0f) app->camRadius = 50.0f;
 }
 
+void App::framebufferSizeCallback(GLFWwindow* window, int width, int height) {
+	App* app = static_cast<App*>(glfwGetWindowUserPointer(window));
+	if (!app || width <= 0 || height <= 0) return; // minimized
+
+	app->width = width;
+	app->height = height;
+	app->aspect = static_cast<float>(width) / static_cast<float>(height);
+	glViewport(0, 0, width, height);
+
+	app->projection = glm::perspective(app->fovY, app->aspect, app->zNear, app->zFar);
+	glUseProgram(app->shader);
+	glUniformMatrix4fv(glGetUniformLocation(app->shader, "projection"), 1, GL_FALSE, glm::value_ptr(app->projection));
+}
+#endif
+
 void App::updateViewUniform() {
-	// Build camera position from spherical coords
-	float x = camRadius * cosf(camElevation) * sinf(camAzimuth);
-	float y = camRadius * sinf(camElevation);
-	float z = camRadius * cosf(camElevation) * cosf(camAzimuth);
-	glm::vec3 camPos = glm::vec3(x, y, z);
+	// Build camera from spherical coords, same construction as the offline renderer
+	LensingCamera camera = LensingCamera::Orbit(camRadius, camAzimuth, camElevation, fovY, aspect, 0, 0);
+	camPos = camera.position;
+	view = camera.view;
 
-	glm::mat4 view = glm::lookAt(camPos, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 	GLint viewLocation = glGetUniformLocation(shader, "view");
 	if (viewLocation != -1) {
 		glUseProgram(shader);
@@ -197,16 +321,28 @@ void App::updateViewUniform() {
 	}
 }
 
+LensingCamera App::lensingCamera(int width, int height) const {
+	return LensingCamera{ camPos, view, fovY, aspect, width, height };
+}
+
 // Function to handle frame timing and update the window title with FPS
 void App::handle_frame_timing() {
-	currentTime = glfwGetTime(); 
+	currentTime = get_time(); 
 	double delta = currentTime - lastTime; 
 
 	if (delta >= 1) {
 		int framerate{ std::max(1, int(numFrames / delta)) }; 
 		std::stringstream title;
 		title << "Sagittarius A running at " << framerate << " fps.";
-		glfwSetWindowTitle(window, title.str().c_str()); // Update the window title
+#ifndef SAGITTARIUS_NO_WINDOW
+		if (window) {
+			glfwSetWindowTitle(window, title.str().c_str()); // Update the window title
+		} else {
+			std::cout << title.str() << std::endl;
+		}
+#else
+		std::cout << title.str() << std::endl;
+#endif
 		lastTime = currentTime; // Reset the last frame time
 		numFrames = -1; // Reset the frame counter
 		frameTime = float(1000.0 / framerate); // Update the frame time
@@ -214,25 +350,3 @@ void App::handle_frame_timing() {
 
 	++numFrames; 
 }
-
-std::vector<Ray> App::InitializeRays(int numRays){
-	std::vector<Ray> rays;
-	rays.reserve(numRays);
-
-
-	for (int i = 0; i < numRays; ++i){
-		glm::vec3 pos;
-		pos.x = -3.5f + ((float)rand() / RAND_MAX) * 0.6f;
-		pos.y = -2.0f + ((float)rand() / RAND_MAX) * 4.0f;
-		pos.z = -0.5f + ((float)rand() / RAND_MAX) * 1.0f; // small offset in Z for 3D spread
-
-		glm::vec3 dir = glm::normalize(glm::vec3(1.0f,
-												  ((float)rand() / RAND_MAX) * 2.0f - 1.0f,
-												  ((float)rand() / RAND_MAX) * 1.0f - 0.5f));
-
-		// Create the Ray and add to the vector
-		rays.emplace_back(pos, dir);
-	}
-
-	return rays; 
-}
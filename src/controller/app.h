@@ -2,24 +2,64 @@
 #include "../config.h"
 #include "../BlackHole.h"
 #include "../Ray.h"
+#include "../LensedBackground.h"
+#include "../view/headless_context.h"
+
+// Where frames go: a GLFW window, or an offscreen framebuffer on a
+// surfaceless EGL context (only when built with SAGITTARIUS_HEADLESS)
+enum class Backend { Window, Headless };
+
+struct HeadlessSettings {
+    int frames = 600;          // frames rendered before run() returns
+    std::string screenshot;    // PPM of the last frame, if not empty
+};
 
 class App {
 public:
-    App();
+    App(Backend backend = Backend::Window, HeadlessSettings headless = HeadlessSettings());
     ~App();
     void run(BlackHole& blackhole);
     void set_up_opengl();
     void make_systems();
+
+    // Screen-space ray stepping: no step moves a ray more than this many
+    // pixels (see ScreenStepControl). 0 keeps fixed affine steps.
+    float pixelTolerance = 0.0f;
+
+    // Infalling particles drawn with the rays (see ParticleSwarm); 0 = none
+    size_t particleCount = 0;
+
+    // Seed for the rays and particles
+    uint64_t seed = 1;
+
+    // Emit rays by impact parameter, concentrated near the photon ring
+    // (see ImpactEmitter), instead of from the slab
+    bool impactEmission = false;
+
+    // Rays emitted; with densityView they are splatted into a screen-space
+    // density grid shown as a heatmap, and keep no trails
+    int rayCount = 200;
+    bool densityView = false;
     
     
 private:
     void set_up_glfw();
+    void set_up_headless();
+    bool keep_running();
+    void present_frame();
+    double get_time();
     void handle_frame_timing();
-    std::vector<Ray> InitializeRays(int numRays);
     
-    GLFWwindow* window;
+    Backend backend;
+    GLFWwindow* window = nullptr;
     unsigned int shader;
 
+    // Surfaceless backend
+    HeadlessSettings headless;
+    HeadlessContext headlessContext;
+    int framesRendered = 0;
+    int width = 800, height = 600;
+
     static constexpr double simulation_scale_factor = 10.0; // How many Schwarzschild radii fit across screen
 
     //Timing
@@ -34,6 +74,19 @@ private:
     float camSensitivity = 0.005f;
     float camZoomSpeed = 0.5f;
 
+    // Projection parameters, shared by the scene shader and the lensing tracer
+    float fovY = glm::radians(45.0f);
+    float aspect = 640.0f / 480.0f;
+    float zNear = 0.1f, zFar = 50.0f;
+    glm::mat4 projection = glm::mat4(1.0f);
+
+    // Current camera, rebuilt by updateViewUniform
+    glm::vec3 camPos = glm::vec3(0.0f);
+    glm::mat4 view = glm::mat4(1.0f);
+
+    // Lensed sky behind the scene
+    bool showLensedBackground = true;
+
     // Mouse state
     bool rotating = false;
     double lastMouseX = 0.0, lastMouseY = 0.0;
@@ -41,7 +94,13 @@ private:
     // Update the view uniform from camera parameters
     void updateViewUniform();
 
+    // Camera description for the per-pixel tracer
+    LensingCamera lensingCamera(int width, int height) const;
+
     static void cursorPosCallback(GLFWwindow* window, double xpos, double ypos);
     static void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
     static void scrollCallback(GLFWwindow* window, double xoffset, double yoffset);
+    // Follows the window size: viewport, projection and width/height (which
+    // the density view reads every frame)
+    static void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 };
\ No newline at end of file
@@ -0,0 +1,18 @@
+#pragma once
+
+// GL-free part of config.h: everything the simulation core may include.
+// Rendering code includes config.h, which adds OpenGL and GLFW on top.
+
+// Include GLM for mathematical operations and transformations
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <random>
+
+// Include standard libraries for input/output and data structures
+#include <iostream>
+#include <vector>
+#include <unordered_map>
+#include <fstream>
+#include <sstream>
+#include <string>
@@ -1,17 +1,51 @@
 // Force program to run on dedicated GPU. Remove if you want to run on your CPU's integrated graphics. 
+#ifdef _WIN32
 extern "C" {
     __declspec(dllexport) unsigned long NvOptimusEnablement = 0x00000001;
 }
+#endif
 
 #include "config.h"
 #include "controller/app.h"
 #include "BlackHole.h"
 
-int main() {
-	srand(static_cast<unsigned int>(time(nullptr)));
+int main(int argc, char** argv) {
+	// --headless renders offscreen through a surfaceless EGL context, for
+	// servers, containers and automated performance runs
+	Backend backend = Backend::Window;
+	HeadlessSettings headless;
+	float pixelTolerance = 0.0f;
+	size_t particleCount = 0;
+	bool impactEmission = false;
+	bool densityView = false;
+	int rayCount = 200;
+	// A different sky of rays every start unless --seed fixes it
+	uint64_t seed = static_cast<uint64_t>(time(nullptr));
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--headless") backend = Backend::Headless;
+		else if (arg == "--frames" && i + 1 < argc) headless.frames = std::atoi(argv[++i]);
+		else if (arg == "--screenshot" && i + 1 < argc) headless.screenshot = argv[++i];
+		else if (arg == "--pixel-tolerance" && i + 1 < argc) pixelTolerance = std::strtof(argv[++i], nullptr);
+		else if (arg == "--impact") impactEmission = true;
+		else if (arg == "--density") densityView = true;
+		else if (arg == "--rays" && i + 1 < argc) rayCount = std::atoi(argv[++i]);
+		else if (arg == "--seed" && i + 1 < argc) seed = std::strtoull(argv[++i], nullptr, 10);
+		else if (arg == "--particles" && i + 1 < argc) particleCount = std::strtoull(argv[++i], nullptr, 10);
+		else {
+			std::cerr << "Usage: " << argv[0] << " [--headless [--frames N] [--screenshot out.ppm]] [--pixel-tolerance PX] [--particles N] [--seed N] [--impact] [--rays N] [--density]" << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
 
 	// Create an instance of the App class to manage the application
-	App* app = new App();
+	App* app = new App(backend, headless);
+	app->pixelTolerance = pixelTolerance;
+	app->particleCount = particleCount;
+	app->seed = seed;
+	app->impactEmission = impactEmission;
+	app->rayCount = rayCount;
+	app->densityView = densityView;
 
 	// Create a black hole object with a specific position and mass
 	BlackHole Sagitarius(glm::vec3(0.0f, 0.0f, 0.0f), 8.54e36);
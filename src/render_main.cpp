@@ -0,0 +1,179 @@
+// Headless offline renderer: traces the lensed sky on the CPU and writes
+// PPM/PNG frames. Needs no GPU, display or OpenGL context.
+#include "TileRenderer.h"
+#include "ImageIO.h"
+#include "Ray.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+// Renders camera with every pixel traced and with the adaptive sampler, and
+// prints the rays each traced and how many 8-bit pixels differ
+static void compareAdaptive(TileRenderer renderer, const LensingCamera& camera){
+    std::vector<glm::vec3> full, adaptive;
+    renderer.adaptive = false;
+    RenderStats fullStats = renderer.Render(camera, full);
+    renderer.adaptive = true;
+    RenderStats adaptiveStats = renderer.Render(camera, adaptive);
+
+    long long off = 0;
+    int worst = 0;
+    for (size_t i = 0; i < full.size(); ++i) {
+        glm::vec3 d = glm::abs(glm::clamp(full[i], 0.0f, 1.0f) - glm::clamp(adaptive[i], 0.0f, 1.0f)) * 255.0f;
+        int difference = static_cast<int>(std::max(d.r, std::max(d.g, d.b)) + 0.5f);
+        worst = std::max(worst, difference);
+        if (difference > 20) ++off;
+    }
+
+    std::cout << "full: " << fullStats.rays << " rays in " << fullStats.seconds << " s" << std::endl;
+    std::cout << "adaptive: " << adaptiveStats.rays << " rays in " << adaptiveStats.seconds << " s (coarse "
+              << renderer.sampler.coarseSpacing << ", threshold " << renderer.sampler.deflectionThreshold << ")" << std::endl;
+    std::cout << double(fullStats.rays) / std::max(adaptiveStats.rays, 1LL) << "x fewer rays; " << off << " pixels ("
+              << 100.0 * double(off) / full.size() << "%) differ by more than 20/255, max " << worst << "/255" << std::endl;
+}
+
+static void printUsage(const char* program){
+    std::cout <<
+        "Usage: " << program << " [options]\n"
+        "  --width N         image width in pixels (800)\n"
+        "  --height N        image height in pixels (600)\n"
+        "  --radius R        orbit camera distance, screen units (5)\n"
+        "  --azimuth DEG     orbit camera azimuth (0)\n"
+        "  --elevation DEG   orbit camera elevation (0)\n"
+        "  --fov DEG         vertical field of view (45)\n"
+        "  --spp N           jittered samples per pixel (1)\n"
+        "  --frames N        number of frames to render (1)\n"
+        "  --orbit DEG       azimuth increment per frame (1)\n"
+        "  --threads N       worker threads, 0 = all cores (0)\n"
+        "  --tile N          tile size in pixels (32)\n"
+        "  --shading MODE    sky | filtered | magnification (sky)\n"
+        "                    filtered and magnification trace ray differentials\n"
+        "  --adaptive        trace a coarse grid, refine near the photon ring\n"
+        "  --coarse N        adaptive: pixels between first-pass samples (16)\n"
+        "  --threshold RAD   adaptive: deflection difference that forces a split (0.05)\n"
+        "  --compare         render the first frame fully and adaptively and report\n"
+        "                    rays traced and pixels that differ; writes no images\n"
+        "  --format ppm|png  output format (png)\n"
+        "  --out PREFIX      output file prefix (lensing)\n";
+}
+
+int main(int argc, char** argv){
+    int width = 800, height = 600;
+    float radius = 5.0f, azimuth = 0.0f, elevation = 0.0f, fov = 45.0f, orbit = 1.0f;
+    int frames = 1;
+    std::string format = "png", prefix = "lensing";
+    bool compare = false;
+
+    // The scene is scaled to the horizon, so the mass only sets the units
+    TileRenderer renderer(Ray::ScreenSchwarzschildRadius(1.0));
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        }
+        if (arg == "--adaptive") {
+            renderer.adaptive = true;
+            continue;
+        }
+        if (arg == "--compare") {
+            compare = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return EXIT_FAILURE;
+        }
+        const char* value = argv[++i];
+
+        if (arg == "--width") width = std::atoi(value);
+        else if (arg == "--height") height = std::atoi(value);
+        else if (arg == "--radius") radius = std::strtof(value, nullptr);
+        else if (arg == "--azimuth") azimuth = std::strtof(value, nullptr);
+        else if (arg == "--elevation") elevation = std::strtof(value, nullptr);
+        else if (arg == "--fov") fov = std::strtof(value, nullptr);
+        else if (arg == "--spp") renderer.samplesPerPixel = std::atoi(value);
+        else if (arg == "--frames") frames = std::atoi(value);
+        else if (arg == "--orbit") orbit = std::strtof(value, nullptr);
+        else if (arg == "--threads") renderer.threads = static_cast<unsigned int>(std::atoi(value));
+        else if (arg == "--tile") renderer.tileSize = std::atoi(value);
+        else if (arg == "--shading") {
+            std::string mode = value;
+            if (mode == "sky") renderer.shading = Shading::Sky;
+            else if (mode == "filtered") renderer.shading = Shading::FilteredSky;
+            else if (mode == "magnification") renderer.shading = Shading::Magnification;
+            else {
+                std::cerr << "Unknown shading " << mode << " (expected sky, filtered or magnification)." << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (arg == "--coarse") renderer.sampler.coarseSpacing = std::atoi(value);
+        else if (arg == "--threshold") renderer.sampler.deflectionThreshold = std::strtof(value, nullptr);
+        else if (arg == "--format") format = value;
+        else if (arg == "--out") prefix = value;
+        else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (width <= 0 || height <= 0 || frames <= 0 || renderer.samplesPerPixel <= 0 || renderer.tileSize <= 0) {
+        std::cerr << "Image size, frames, spp and tile size must be positive." << std::endl;
+        return EXIT_FAILURE;
+    }
+    if ((renderer.adaptive || compare) && renderer.shading != Shading::Sky) {
+        std::cerr << "--adaptive and --compare only support --shading sky." << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (format != "ppm" && format != "png") {
+        std::cerr << "Unknown format " << format << " (expected ppm or png)." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (compare) {
+        compareAdaptive(renderer, LensingCamera::Orbit(
+            radius, glm::radians(azimuth), glm::radians(elevation),
+            glm::radians(fov), float(width) / float(height), width, height));
+        return 0;
+    }
+
+    std::vector<glm::vec3> image;
+    RenderStats total;
+    for (int frame = 0; frame < frames; ++frame) {
+        LensingCamera camera = LensingCamera::Orbit(
+            radius, glm::radians(azimuth + frame * orbit), glm::radians(elevation),
+            glm::radians(fov), float(width) / float(height), width, height);
+
+        RenderStats stats = renderer.Render(camera, image);
+        total.pixels += stats.pixels;
+        total.rays += stats.rays;
+        total.steps += stats.steps;
+        total.seconds += stats.seconds;
+
+        char path[512];
+        if (frames == 1) std::snprintf(path, sizeof(path), "%s.%s", prefix.c_str(), format.c_str());
+        else std::snprintf(path, sizeof(path), "%s_%04d.%s", prefix.c_str(), frame, format.c_str());
+
+        bool written = format == "png" ? WritePNG(path, image, width, height)
+                                       : WritePPM(path, image, width, height);
+        if (!written) {
+            std::cerr << "Failed to write " << path << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::cout << path << ": " << stats.rays << " rays for " << stats.pixels << " pixel samples in "
+                  << stats.seconds << " s, " << stats.RaysPerSecond() << " rays/s, " << stats.StepsPerSecond() << " steps/s" << std::endl;
+    }
+
+    if (frames > 1) {
+        std::cout << "total: " << total.rays << " rays in " << total.seconds << " s, "
+                  << total.RaysPerSecond() << " rays/s, " << total.StepsPerSecond() << " steps/s" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,320 @@
+#include "gl_renderer.h"
+#include "shader.h"
+
+GLRenderer::GLRenderer(GLuint shaderProgram) : shader(shaderProgram) {
+    SetupBlackHoleMesh();
+    SetupRayMesh();
+    SetupParticleMesh();
+    // The density quad and its shader are made on the first DrawDensity, so
+    // views without a density grid do not pay for them
+}
+
+GLRenderer::~GLRenderer() {
+    glDeleteVertexArrays(1, &sphereVAO);
+    glDeleteBuffers(1, &sphereVBO);
+    glDeleteBuffers(1, &sphereEBO);
+    glDeleteVertexArrays(1, &headVAO);
+    glDeleteBuffers(1, &headVBO);
+    glDeleteVertexArrays(1, &trailVAO);
+    glDeleteBuffers(1, &trailVBO);
+    glDeleteVertexArrays(1, &particleVAO);
+    glDeleteBuffers(1, &particleVBO);
+    glDeleteVertexArrays(1, &densityVAO);
+    glDeleteBuffers(1, &densityVBO);
+    glDeleteTextures(1, &densityTexture);
+    glDeleteProgram(densityShader);
+}
+
+void GLRenderer::SetupBlackHoleMesh(){
+    // Generate vertex data for a sphere representation of the black hole (UV sphere)
+    std::vector<float> vertices; // interleaved: pos(3), tex(3), normal(3)
+    std::vector<unsigned int> indices;
+
+    const int sectorCount = 36; // longitudinal slices
+    const int stackCount = 18;  // latitudinal stacks
+    // Compute visual radius in screen/world units to match ray integration stopping radius.
+    float radius = 6.0f / static_cast<float>(Ray::simulation_scale_factor);
+
+    for (int i = 0; i <= stackCount; ++i) {
+        float stackAngle = glm::pi<float>() / 2 - i * (glm::pi<float>() / stackCount); // from pi/2 to -pi/2
+        float xy = radius * cosf(stackAngle); // r * cos(u)
+        float z = radius * sinf(stackAngle);  // r * sin(u)
+
+        for (int j = 0; j <= sectorCount; ++j) {
+            float sectorAngle = j * (2 * glm::pi<float>() / sectorCount); // 0 to 2pi
+            float x = xy * cosf(sectorAngle);
+            float y = xy * sinf(sectorAngle);
+
+            // position
+            vertices.push_back(x);
+            vertices.push_back(y);
+            vertices.push_back(z);
+            // texcoord placeholder (vec3 to match shader layout)
+            vertices.push_back((float)j / sectorCount);
+            vertices.push_back((float)i / stackCount);
+            vertices.push_back(0.0f);
+            // normal (normalize position)
+            glm::vec3 n = glm::normalize(glm::vec3(x, y, z));
+            vertices.push_back(n.x);
+            vertices.push_back(n.y);
+            vertices.push_back(n.z);
+        }
+    }
+
+    // indices
+    for (int i = 0; i < stackCount; ++i) {
+        int k1 = i * (sectorCount + 1);     // beginning of current stack
+        int k2 = k1 + sectorCount + 1;      // beginning of next stack
+
+        for (int j = 0; j < sectorCount; ++j, ++k1, ++k2) {
+            if (i != 0) {
+                indices.push_back(k1);
+                indices.push_back(k2);
+                indices.push_back(k1 + 1);
+            }
+
+            if (i != (stackCount-1)) {
+                indices.push_back(k1 + 1);
+                indices.push_back(k2);
+                indices.push_back(k2 + 1);
+            }
+        }
+    }
+
+    sphereIndexCount = static_cast<GLsizei>(indices.size());
+
+    glGenVertexArrays(1, &sphereVAO);
+    glGenBuffers(1, &sphereVBO);
+    glGenBuffers(1, &sphereEBO);
+
+    glBindVertexArray(sphereVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, sphereVBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+    GLsizei stride = 9 * sizeof(float);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+
+    glBindVertexArray(0);
+}
+
+void GLRenderer::DrawBlackHole(const BlackHole& blackhole){
+    glUseProgram(shader);
+
+    // Pass model matrix
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), blackhole.position);
+    GLint ModelLoc = glGetUniformLocation(shader, "model");
+    glUniformMatrix4fv(ModelLoc, 1, GL_FALSE, glm::value_ptr(model));
+
+    // Set the color uniform (e.g., red color)
+    GLint colorLocation = glGetUniformLocation(shader, "color");
+    glUniform3f(colorLocation, 1.0f, 0.0f, 0.0f); // Set color to red
+
+    glBindVertexArray(sphereVAO);
+    if (sphereIndexCount > 0) {
+        glDrawElements(GL_TRIANGLES, sphereIndexCount, GL_UNSIGNED_INT, 0);
+    }
+    glBindVertexArray(0);
+}
+
+void GLRenderer::SetupRayMesh(){
+    // --- Setup point ---
+    glGenVertexArrays(1, &headVAO);
+    glGenBuffers(1, &headVBO);
+
+    glBindVertexArray(headVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, headVBO);
+
+    // Initially with a single point
+    glm::vec4 point = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4), &point, GL_DYNAMIC_DRAW);
+
+    // Vertex attribute 0: position
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    // Vertex attribute 3: alpha stored in w component
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(3);
+
+    glBindVertexArray(0);
+
+    // --- Setup trail ---
+    glGenVertexArrays(1, &trailVAO);
+    glGenBuffers(1, &trailVBO);
+
+    glBindVertexArray(trailVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, trailVBO);
+
+    // empty buffer for now, will update every frame
+    glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW);
+
+    // Vertex attribute 0: position
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    // Vertex atttribute 3: alpha
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(3);
+
+    glBindVertexArray(0);
+}
+
+void GLRenderer::DrawRays(const std::vector<Ray>& rays){
+    glUseProgram(shader);
+
+    // Turn on blending for the trails
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glLineWidth(1.0f);
+
+    for (auto& ray: rays){
+        // ---- Draw Ray trail ----
+        // All rays share one trail buffer, re-specified for each ray
+        if (!ray.trail.empty()){
+            glBindBuffer(GL_ARRAY_BUFFER, trailVBO);
+            glBufferData(GL_ARRAY_BUFFER,
+                        ray.trail.size() * sizeof(glm::vec4),
+                        ray.trail.data(),
+                        GL_DYNAMIC_DRAW);
+            
+            GLint ModelLoc = glGetUniformLocation(shader, "model");
+            glUniformMatrix4fv(ModelLoc, 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f))); // Use identity matrix for trail
+             
+            GLint colorLocation = glGetUniformLocation(shader, "color");
+            glUniform3f(colorLocation, 1.0f, 1.0f, 1.0f);
+
+            glBindVertexArray(trailVAO);
+            glDrawArrays(GL_LINE_STRIP, 0, ray.trail.size());
+            glBindVertexArray(0);
+        }
+
+        // ---- Draw the Ray head ----
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), ray.position);
+        GLint ModelLoc = glGetUniformLocation(shader, "model");
+        glUniformMatrix4fv(ModelLoc, 1, GL_FALSE, glm::value_ptr(model));
+
+        GLint colorLocation = glGetUniformLocation(shader, "color");
+        glUniform3f(colorLocation, 1.0f, 1.0f, 1.0f); 
+
+        glBindVertexArray(headVAO);
+        glPointSize(1.0f);
+        glDrawArrays(GL_POINTS, 0, 1); 
+        glBindVertexArray(0);
+    }
+
+    glDisable(GL_BLEND);
+
+}
+
+void GLRenderer::SetupParticleMesh(){
+    glGenVertexArrays(1, &particleVAO);
+    glGenBuffers(1, &particleVBO);
+
+    glBindVertexArray(particleVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, particleVBO);
+    glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STREAM_DRAW);
+
+    // Same layout as the ray buffers: position, then brightness as alpha
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(3);
+
+    glBindVertexArray(0);
+}
+
+void GLRenderer::DrawParticles(const ParticleSwarm& particles){
+    if (particles.positions.empty()) return;
+    glUseProgram(shader);
+
+    // One upload and one draw call for the whole swarm. The buffer is
+    // orphaned each frame so the driver need not wait for the last draw.
+    size_t count = particles.positions.size();
+    glBindBuffer(GL_ARRAY_BUFFER, particleVBO);
+    if (count > particleCapacity) particleCapacity = count;
+    glBufferData(GL_ARRAY_BUFFER, particleCapacity * sizeof(glm::vec4), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(glm::vec4), particles.positions.data());
+
+    GLint ModelLoc = glGetUniformLocation(shader, "model");
+    glUniformMatrix4fv(ModelLoc, 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f)));
+    GLint colorLocation = glGetUniformLocation(shader, "color");
+    glUniform3f(colorLocation, 1.0f, 0.6f, 0.2f);
+
+    // Additive: dense regions of the flow glow
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+    glPointSize(2.0f);
+    glBindVertexArray(particleVAO);
+    glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(count));
+    glBindVertexArray(0);
+    glPointSize(1.0f);
+    glDisable(GL_BLEND);
+}
+
+void GLRenderer::SetupDensityMesh(){
+    // Same full screen pass as the lensed background
+    densityShader = make_shader(
+        "../src/shaders/background_vertex.txt",
+        "../src/shaders/background_fragment.txt");
+
+    const float quad[] = {
+        -1.0f, -1.0f,
+         1.0f, -1.0f,
+        -1.0f,  1.0f,
+         1.0f,  1.0f,
+    };
+    glGenVertexArrays(1, &densityVAO);
+    glGenBuffers(1, &densityVBO);
+    glBindVertexArray(densityVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, densityVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+
+    glGenTextures(1, &densityTexture);
+    glBindTexture(GL_TEXTURE_2D, densityTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void GLRenderer::DrawDensity(const DensityGrid& density){
+    int w, h;
+    std::vector<glm::vec3> pixels = density.ToneMap(w, h);
+    if (pixels.empty()) return;
+    if (!densityShader) SetupDensityMesh();
+
+    glBindTexture(GL_TEXTURE_2D, densityTexture);
+    if (w != densityWidth || h != densityHeight) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, w, h, 0, GL_RGB, GL_FLOAT, pixels.data());
+        densityWidth = w;
+        densityHeight = h;
+    } else {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, GL_RGB, GL_FLOAT, pixels.data());
+    }
+
+    // Additive over the scene, so the black hole and background stay visible
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glUseProgram(densityShader);
+    glActiveTexture(GL_TEXTURE0);
+    GLint skyLocation = glGetUniformLocation(densityShader, "sky");
+    glUniform1i(skyLocation, 0);
+    glBindVertexArray(densityVAO);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "../config.h"
+#include "../Renderer.h"
+
+// OpenGL implementation of Renderer: a UV sphere for the black hole, line
+// strips for the trails and points for the ray heads. Needs a current context.
+class GLRenderer : public Renderer {
+public:
+    GLRenderer(GLuint shaderProgram);
+    ~GLRenderer();
+
+    void DrawBlackHole(const BlackHole& blackhole) override;
+    void DrawRays(const std::vector<Ray>& rays) override;
+    void DrawParticles(const ParticleSwarm& particles) override;
+    void DrawDensity(const DensityGrid& density) override;
+
+private:
+    // Set up the mesh for rendering the black hole
+    void SetupBlackHoleMesh();
+    // Set up the point and trail buffers shared by all rays
+    void SetupRayMesh();
+    // Set up the point buffer the whole particle swarm is drawn from
+    void SetupParticleMesh();
+    // Set up the full screen quad, texture and shader the density is shown
+    // with (on first use). The quad covers the viewport: a screen grid lines
+    // up with the camera it was splatted with, while a volume grid is shown
+    // as its fixed projection along z, whatever the camera.
+    void SetupDensityMesh();
+
+    GLuint shader;
+
+    GLuint sphereVAO, sphereVBO, sphereEBO;
+    GLsizei sphereIndexCount = 0;
+
+    GLuint headVAO, headVBO;
+    GLuint trailVAO, trailVBO;
+    GLuint particleVAO, particleVBO;
+    size_t particleCapacity = 0;    // vertices the particle buffer was allocated for
+
+    GLuint densityVAO = 0, densityVBO = 0, densityTexture = 0, densityShader = 0;  // 0 until the first DrawDensity
+    int densityWidth = 0, densityHeight = 0;    // current texture size
+};
@@ -0,0 +1,23 @@
+#pragma once
+#include "../config.h"
+
+// Surfaceless OpenGL context for display-less machines. Uses EGL with the
+// EGL_MESA_platform_surfaceless platform (GPU drivers or llvmpipe) and renders
+// into an offscreen framebuffer object instead of a window.
+// Only available when built with SAGITTARIUS_HEADLESS.
+struct HeadlessContext{
+    int width = 0, height = 0;
+    GLuint fbo = 0, colorBuffer = 0, depthBuffer = 0;
+
+    // Create the context, make it current, load GL and bind the framebuffer.
+    // Prints the reason and returns false on failure.
+    bool Create(int width, int height);
+    void Destroy();
+
+    // Read back the framebuffer (row 0 at the bottom)
+    void ReadPixels(std::vector<glm::vec3>& pixels) const;
+
+private:
+    void* display = nullptr;   // EGLDisplay
+    void* context = nullptr;   // EGLContext
+};